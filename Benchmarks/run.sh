@@ -0,0 +1,9 @@
+#!/bin/sh
+# times every benchmark with the JIT and without it
+# usage: sh Benchmarks/run.sh [path to unn]
+UNN=${1:-./unn}
+for file in Benchmarks/*.unn; do
+        echo "== $file"
+        "$UNN" --time "$file" > /dev/null
+        "$UNN" --time --no-jit "$file" > /dev/null
+done
@@ -0,0 +1,491 @@
+// here is the incremental build (see Build.h) modules are found with the import pre-scan, sorted topologically and then
+// compiled by a pool of threads that take modules off a ready queue as soon as everything they import is finished
+
+#include <sys/stat.h> // stat and mkdir
+#include <dirent.h> // walking a directory of modules
+#include <unistd.h> // access
+#include <limits.h> // PATH_MAX
+#include "Bytecode.h" // disassemble for --disasm
+#include "Build.h"
+
+#define MANIFEST_HEADER "UNNBUILD" // first word of the manifest followed by MODULE_VERSION
+
+static BuildModule *module_for(Build *build, const char *path) {
+        // path ids come out of the symbol table in order so a new path always gets the next index
+        size_t id = (size_t)symbol_intern(&build->paths, path);
+        if (id < build->moduleCount) return build->modules[id];
+        if (build->moduleCount >= build->moduleCap) {
+                size_t newCap = build->moduleCap ? build->moduleCap * 2 : 64;
+                BuildModule **newModules = realloc(build->modules, sizeof(BuildModule *) * newCap);
+                if (!newModules) {
+                        fprintf(stderr, "BUILD ERROR: Out of memory\n");
+                        exit(1);
+                }
+                build->modules = newModules;
+                build->moduleCap = newCap;
+        }
+        BuildModule *module = calloc(1, sizeof(BuildModule));
+        if (!module) {
+                fprintf(stderr, "BUILD ERROR: Out of memory\n");
+                exit(1);
+        }
+        module->path = strdup(path);
+        build->modules[build->moduleCount++] = module;
+        return module;
+}
+
+// object and interface files are named after the hash of the source path so every module gets its own pair
+static void artifact(const Build *build, const BuildModule *module, const char *extension, char *out) {
+        unsigned long long hash = module_hash(module->path, strlen(module->path), MODULE_HASH_SEED);
+        snprintf(out, PATH_MAX, "%s/%s/%016llx.%s", build->root, BUILD_DIR, hash, extension);
+}
+
+// one line per module: path mtime size source hash interface hash imports hash import count imports (tab separated)
+static void load_manifest(Build *build) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s/%s", build->root, BUILD_DIR, BUILD_MANIFEST);
+        char *data = read_source(path, NULL);
+        if (!data) return;
+
+        char *line = data, *end = strchr(line, '\n'), header[32];
+        snprintf(header, sizeof(header), "%s %d", MANIFEST_HEADER, MODULE_VERSION);
+        // a manifest from a different version is thrown away and everything gets built again
+        if (!end || (size_t)(end - line) != strlen(header) || strncmp(line, header, strlen(header)) != 0) {
+                free(data);
+                return;
+        }
+        for (line = end + 1; (end = strchr(line, '\n')); line = end + 1) {
+                *end = '\0';
+                char *save = NULL;
+                char *fields[7];
+                int count = 0;
+                for (char *field = strtok_r(line, "\t", &save); field; field = count < 7 ? strtok_r(NULL, "\t", &save) : NULL) {
+                        fields[count++] = field;
+                }
+                if (count < 7) continue;
+                size_t importCount = strtoul(fields[6], NULL, 10);
+                char **imports = malloc(sizeof(char *) * (importCount + 1));
+                size_t found = 0;
+                for (char *field; found < importCount && (field = strtok_r(NULL, "\t", &save)); found++) imports[found] = strdup(field);
+                if (found != importCount) {
+                        while (found > 0) free(imports[--found]);
+                        free(imports);
+                        continue;
+                }
+                BuildModule *module = module_for(build, fields[0]);
+                module->known = 1;
+                module->oldMtime = strtoll(fields[1], NULL, 10);
+                module->oldSize = strtoll(fields[2], NULL, 10);
+                module->oldSourceHash = strtoull(fields[3], NULL, 16);
+                module->oldInterfaceHash = strtoull(fields[4], NULL, 16);
+                module->oldDepsHash = strtoull(fields[5], NULL, 16);
+                module->imports = imports;
+                module->importCount = importCount;
+        }
+        free(data);
+}
+
+static void write_manifest(Build *build) {
+        char path[PATH_MAX], temp[PATH_MAX + 8];
+        snprintf(path, sizeof(path), "%s/%s/%s", build->root, BUILD_DIR, BUILD_MANIFEST);
+        snprintf(temp, sizeof(temp), "%s.tmp", path);
+        FILE *file = fopen(temp, "w");
+        if (!file) {
+                fprintf(stderr, "BUILD ERROR: Could not write '%s'\n", path);
+                return;
+        }
+        fprintf(file, "%s %d\n", MANIFEST_HEADER, MODULE_VERSION);
+        // failed modules are left out so they get compiled again next time, modules this build never reached keep their old
+        // record so building one entry file does not throw away what a build of the whole directory knew
+        for (size_t i = 0; i < build->moduleCount; i++) {
+                const BuildModule *module = build->modules[i];
+                if (module->reachable ? module->state != MODULE_BUILT : !module->known) continue;
+                if (module->reachable) {
+                        fprintf(file, "%s\t%lld\t%lld\t%016llx\t%016llx\t%016llx\t%zu", module->path, module->mtime, module->size,
+                                module->sourceHash, module->interfaceHash, module->depsHash, module->importCount);
+                } else {
+                        fprintf(file, "%s\t%lld\t%lld\t%016llx\t%016llx\t%016llx\t%zu", module->path, module->oldMtime, module->oldSize,
+                                module->oldSourceHash, module->oldInterfaceHash, module->oldDepsHash, module->importCount);
+                }
+                for (size_t j = 0; j < module->importCount; j++) fprintf(file, "\t%s", module->imports[j]);
+                fputc('\n', file);
+        }
+        if (fclose(file) != 0 || rename(temp, path) != 0) {
+                fprintf(stderr, "BUILD ERROR: Could not write '%s'\n", path);
+                remove(temp);
+        }
+}
+
+static void add_user(BuildModule *module, BuildModule *user) {
+        if (module->userCount >= module->userCap) {
+                size_t newCap = module->userCap ? module->userCap * 2 : 4;
+                BuildModule **newUsers = realloc(module->users, sizeof(BuildModule *) * newCap);
+                if (!newUsers) {
+                        fprintf(stderr, "BUILD ERROR: Out of memory\n");
+                        exit(1);
+                }
+                module->users = newUsers;
+                module->userCap = newCap;
+        }
+        module->users[module->userCount++] = user;
+}
+
+// reads the imports of one module, from the manifest when the file has not changed or from the source when it has
+static int scan_module(BuildModule *module) {
+        struct stat info;
+        if (stat(module->path, &info) != 0) {
+                fprintf(stderr, "IMPORT ERROR: Cannot read '%s'\n", module->path);
+                return 0;
+        }
+        module->mtime = (long long)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+        module->size = (long long)info.st_size;
+        if (module->known && module->mtime == module->oldMtime && module->size == module->oldSize) {
+                module->sourceHash = module->oldSourceHash;
+                return 1;
+        }
+
+        for (size_t i = 0; i < module->importCount; i++) free(module->imports[i]);
+        free(module->imports);
+        module->imports = NULL;
+        module->importCount = 0;
+
+        size_t length = 0;
+        char *source = read_source(module->path, &length);
+        if (!source) {
+                fprintf(stderr, "IMPORT ERROR: Cannot read '%s'\n", module->path);
+                return 0;
+        }
+        module->sourceHash = module_hash(source, length, MODULE_HASH_SEED);
+        char **paths;
+        size_t count = module_scan_imports(source, &paths);
+        free(source);
+
+        int ok = 1;
+        module->imports = malloc(sizeof(char *) * (count + 1));
+        for (size_t i = 0; i < count; i++) {
+                char *resolved = module_resolve(module->path, paths[i]);
+                if (!resolved) {
+                        fprintf(stderr, "IMPORT ERROR: Cannot find module '%s' \nMODULE : %s\n", paths[i], module->path);
+                        ok = 0;
+                } else module->imports[module->importCount++] = resolved;
+                free(paths[i]);
+        }
+        free(paths);
+        return ok;
+}
+
+// walks the imports from the roots marking everything it finds reachable and linking up the graph, the stack starts out
+// holding the roots and grows as modules are found (every module is pushed once at most)
+static int discover(Build *build, BuildModule **stack, size_t top, size_t cap) {
+        int ok = 1;
+        while (top > 0) {
+                BuildModule *module = stack[--top];
+                if (!scan_module(module)) {
+                        ok = 0;
+                        continue;
+                }
+                module->deps = malloc(sizeof(BuildModule *) * (module->importCount + 1));
+                for (size_t i = 0; i < module->importCount; i++) {
+                        BuildModule *dep = module_for(build, module->imports[i]);
+                        module->deps[i] = dep;
+                        add_user(dep, module);
+                        if (dep->reachable) continue;
+                        dep->reachable = 1;
+                        if (top >= cap) {
+                                cap = cap ? cap * 2 : 16;
+                                BuildModule **grown = realloc(stack, sizeof(BuildModule *) * cap);
+                                if (!grown) {
+                                        fprintf(stderr, "BUILD ERROR: Out of memory\n");
+                                        exit(1);
+                                }
+                                stack = grown;
+                        }
+                        stack[top++] = dep;
+                }
+        }
+        free(stack);
+        return ok;
+}
+
+// Kahn's algorithm, anything left over at the end is part of an import cycle
+static int sort_modules(Build *build) {
+        size_t reachable = 0;
+        for (size_t i = 0; i < build->moduleCount; i++) reachable += build->modules[i]->reachable;
+        build->order = malloc(sizeof(BuildModule *) * (reachable + 1));
+        build->queue = malloc(sizeof(BuildModule *) * (reachable + 1));
+        if (!build->order || !build->queue) {
+                fprintf(stderr, "BUILD ERROR: Out of memory\n");
+                exit(1);
+        }
+        for (size_t i = 0; i < build->moduleCount; i++) {
+                BuildModule *module = build->modules[i];
+                module->pending = (int)module->importCount;
+                if (module->reachable && module->pending == 0) build->order[build->orderCount++] = module;
+        }
+        for (size_t next = 0; next < build->orderCount; next++) {
+                BuildModule *module = build->order[next];
+                for (size_t i = 0; i < module->userCount; i++) {
+                        if (--module->users[i]->pending == 0) build->order[build->orderCount++] = module->users[i];
+                }
+        }
+        if (build->orderCount == reachable) return 1;
+        // every leftover module has a leftover import so following them long enough has to end up going round the cycle
+        BuildModule *cycle = NULL;
+        for (size_t i = 0; i < build->moduleCount && !cycle; i++) {
+                if (build->modules[i]->reachable && build->modules[i]->pending > 0) cycle = build->modules[i];
+        }
+        for (size_t step = 0; cycle && step < build->moduleCount; step++) {
+                for (size_t i = 0; i < cycle->importCount; i++) {
+                        if (cycle->deps[i]->pending > 0) {
+                                cycle = cycle->deps[i];
+                                break;
+                        }
+                }
+        }
+        if (cycle) fprintf(stderr, "IMPORT ERROR: Import cycle through '%s'\n", cycle->path);
+        return 0;
+}
+
+// interfaces of modules that were up to date are only read from disk once something that imports them gets compiled
+static int load_interface(Build *build, BuildModule *module) {
+        pthread_mutex_lock(&build->ifaceLock);
+        if (!module->ifaceLoaded) {
+                char path[PATH_MAX];
+                artifact(build, module, "unni", path);
+                module->ifaceLoaded = interface_read(path, &module->iface) && module->iface.hash == module->interfaceHash;
+                if (!module->ifaceLoaded) {
+                        interface_free(&module->iface);
+                        fprintf(stderr, "BUILD ERROR: Interface of '%s' is missing or out of date remove %s to rebuild\n", module->path, BUILD_DIR);
+                }
+        }
+        int ok = module->ifaceLoaded;
+        pthread_mutex_unlock(&build->ifaceLock);
+        return ok;
+}
+
+// brings one module up to date and returns 1 if it had to be compiled
+static int build_module(Build *build, BuildModule *module) {
+        char object[PATH_MAX], interface[PATH_MAX];
+        artifact(build, module, "unnc", object);
+        artifact(build, module, "unni", interface);
+
+        module->depsHash = MODULE_HASH_SEED;
+        for (size_t i = 0; i < module->importCount; i++) {
+                // a module whose import failed is skipped the import already printed its errors
+                if (module->deps[i]->state != MODULE_BUILT) {
+                        module->state = MODULE_FAILED;
+                        return 0;
+                }
+                module->depsHash = module_hash(&module->deps[i]->interfaceHash, sizeof(unsigned long long), module->depsHash);
+        }
+        int stale = !module->known || module->sourceHash != module->oldSourceHash || module->depsHash != module->oldDepsHash ||
+                    access(object, R_OK) != 0 || access(interface, R_OK) != 0;
+        if (!stale) {
+                module->interfaceHash = module->oldInterfaceHash;
+                module->state = MODULE_BUILT;
+                return 0;
+        }
+
+        module->state = MODULE_FAILED;
+        size_t length = 0;
+        char *source = read_source(module->path, &length);
+        if (!source) {
+                fprintf(stderr, "BUILD ERROR: Cannot read '%s'\n", module->path);
+                return 1;
+        }
+        module->sourceHash = module_hash(source, length, MODULE_HASH_SEED);
+        Interface *imports = malloc(sizeof(Interface) * (module->importCount + 1));
+        int ok = imports != NULL;
+        for (size_t i = 0; ok && i < module->importCount; i++) {
+                ok = load_interface(build, module->deps[i]);
+                if (ok) imports[i] = module->deps[i]->iface; // shallow copy the dep keeps owning the names
+        }
+
+        // the errors go into a buffer of this module and stderr is only locked to copy it out so the errors of one module
+        // stay together without the other threads waiting for the whole compile
+        Interface iface;
+        char *errors = NULL;
+        size_t errorsLength = 0;
+        errorStream = open_memstream(&errors, &errorsLength);
+        if (!errorStream) flockfile(stderr); // no buffer so the errors go straight out with everyone else waiting
+        if (ok) ok = module_compile(module->path, source, imports, module->importCount, object, &iface);
+        if (errorStream) {
+                fclose(errorStream);
+                errorStream = NULL;
+                flockfile(stderr);
+        }
+        if (errors) fwrite(errors, 1, errorsLength, stderr);
+        if (!ok) fprintf(stderr, "BUILD ERROR: '%s' did not compile\n", module->path);
+        funlockfile(stderr);
+        free(errors);
+        free(imports);
+        free(source);
+        if (!ok) return 1;
+
+        // an unchanged interface is not written again so its mtime shows when it last really changed
+        if ((iface.hash != module->oldInterfaceHash || access(interface, R_OK) != 0) && !interface_write(interface, &iface)) {
+                fprintf(stderr, "BUILD ERROR: Could not write '%s'\n", interface);
+                interface_free(&iface);
+                return 1;
+        }
+        module->interfaceHash = iface.hash;
+        module->iface = iface;
+        module->ifaceLoaded = 1;
+        module->state = MODULE_BUILT;
+        return 1;
+}
+
+static void *build_worker(void *arg) {
+        Build *build = arg;
+        pthread_mutex_lock(&build->lock);
+        while (1) {
+                while (build->queueHead == build->queueTail && build->remaining > 0) pthread_cond_wait(&build->ready, &build->lock);
+                if (build->remaining == 0) break;
+                BuildModule *module = build->queue[build->queueHead++];
+                pthread_mutex_unlock(&build->lock);
+                int compiled = build_module(build, module);
+                pthread_mutex_lock(&build->lock);
+                build->compiled += compiled;
+                build->failed += module->state == MODULE_FAILED;
+                build->remaining--;
+                // anything that was only waiting on this module can go now
+                for (size_t i = 0; i < module->userCount; i++) {
+                        BuildModule *user = module->users[i];
+                        if (user->reachable && --user->pending == 0) build->queue[build->queueTail++] = user;
+                }
+                pthread_cond_broadcast(&build->ready);
+        }
+        pthread_mutex_unlock(&build->lock);
+        return NULL;
+}
+
+// every .unn file under dir (hidden directories like .unnbuild are skipped)
+static void collect(Build *build, const char *dir, BuildModule ***stack, size_t *top, size_t *cap) {
+        DIR *handle = opendir(dir);
+        if (!handle) return;
+        struct dirent *entry;
+        while ((entry = readdir(handle))) {
+                if (entry->d_name[0] == '.') continue;
+                char path[PATH_MAX];
+                if (snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name) >= (int)sizeof(path)) continue;
+                size_t len = strlen(entry->d_name);
+                int isDir = entry->d_type == DT_DIR;
+                if (entry->d_type == DT_UNKNOWN) {
+                        struct stat info;
+                        isDir = stat(path, &info) == 0 && S_ISDIR(info.st_mode);
+                }
+                if (isDir) collect(build, path, stack, top, cap);
+                else if (len > 4 && strcmp(entry->d_name + len - 4, ".unn") == 0) {
+                        BuildModule *module = module_for(build, path);
+                        if (module->reachable) continue;
+                        module->reachable = 1;
+                        if (*top >= *cap) {
+                                *cap = *cap ? *cap * 2 : 64;
+                                *stack = realloc(*stack, sizeof(BuildModule *) * *cap);
+                        }
+                        (*stack)[(*top)++] = module;
+                }
+        }
+        closedir(handle);
+}
+
+int build_run(Build *build, const char *path, int jobs) {
+        memset(build, 0, sizeof(Build));
+        symbol_table_init(&build->paths);
+        pthread_mutex_init(&build->lock, NULL);
+        pthread_mutex_init(&build->ifaceLock, NULL);
+        pthread_cond_init(&build->ready, NULL);
+
+        char resolved[PATH_MAX];
+        struct stat info;
+        if (!realpath(path, resolved) || stat(resolved, &info) != 0) {
+                fprintf(stderr, "BUILD ERROR: Cannot find '%s'\n", path);
+                return 1;
+        }
+        int isDir = S_ISDIR(info.st_mode);
+        build->root = strdup(resolved);
+        if (!isDir) *strrchr(build->root, '/') = '\0';
+        load_manifest(build);
+
+        size_t top = 0, cap = 0;
+        BuildModule **roots = NULL;
+        if (isDir) collect(build, resolved, &roots, &top, &cap);
+        else {
+                BuildModule *module = module_for(build, resolved);
+                module->reachable = 1;
+                roots = malloc(sizeof(BuildModule *));
+                roots[top++] = module;
+                cap = 1;
+        }
+        // discover frees the roots when it is done with them
+        int ok = discover(build, roots, top, cap) && sort_modules(build);
+        if (!ok) return 1;
+
+        char dir[PATH_MAX];
+        snprintf(dir, sizeof(dir), "%s/%s", build->root, BUILD_DIR);
+        if (mkdir(dir, 0777) != 0 && access(dir, W_OK) != 0) {
+                fprintf(stderr, "BUILD ERROR: Cannot create '%s'\n", dir);
+                return 1;
+        }
+
+        // modules with no imports start off the queue the rest get added as their imports finish
+        for (size_t i = 0; i < build->orderCount; i++) {
+                BuildModule *module = build->order[i];
+                module->pending = (int)module->importCount;
+                if (module->pending == 0) build->queue[build->queueTail++] = module;
+        }
+        build->remaining = build->orderCount;
+        if (jobs < 1) jobs = 1;
+        if ((size_t)jobs > build->orderCount) jobs = build->orderCount > 0 ? (int)build->orderCount : 1;
+        pthread_t *threads = malloc(sizeof(pthread_t) * jobs);
+        int started = 0;
+        while (threads && started < jobs - 1 && pthread_create(&threads[started], NULL, build_worker, build) == 0) started++;
+        build_worker(build);
+        for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+        free(threads);
+
+        write_manifest(build);
+        return build->failed ? 1 : 0;
+}
+
+int build_exec(Build *build, VM *vm, FILE *listing) {
+        // everything is loaded first so the top level of a module can call into anything it imports
+        Function **mains = malloc(sizeof(Function *) * (build->orderCount + 1));
+        for (size_t i = 0; i < build->orderCount; i++) {
+                char object[PATH_MAX];
+                artifact(build, build->order[i], "unnc", object);
+                if (!(mains[i] = module_load(vm, object, build->order[i]->path))) {
+                        free(mains);
+                        return 1;
+                }
+        }
+        if (listing) {
+                for (size_t i = 0; i < vm->functionCount; i++) disassemble(vm, vm->functions[i], listing);
+        }
+        int status = 0;
+        for (size_t i = 0; i < build->orderCount && status == 0; i++) status = vm_run(vm, mains[i]);
+        free(mains);
+        return status;
+}
+
+void build_free(Build *build) {
+        for (size_t i = 0; i < build->moduleCount; i++) {
+                BuildModule *module = build->modules[i];
+                for (size_t j = 0; j < module->importCount; j++) free(module->imports[j]);
+                free(module->imports);
+                free(module->deps);
+                free(module->users);
+                interface_free(&module->iface);
+                free(module->path);
+                free(module);
+        }
+        free(build->modules);
+        free(build->order);
+        free(build->queue);
+        free(build->root);
+        symbol_table_free(&build->paths);
+        pthread_mutex_destroy(&build->lock);
+        pthread_mutex_destroy(&build->ifaceLock);
+        pthread_cond_destroy(&build->ready);
+        memset(build, 0, sizeof(Build));
+}
@@ -0,0 +1,79 @@
+// this is the header for the incremental build of programs made of several modules (see Module.h for the files it makes)
+//
+// a build goes like this
+//   1. every reachable file is found by scanning the imports at the top of each source (module_scan_imports), a file whose
+//      size and mtime match the manifest is not even opened, the imports saved in the manifest are used instead
+//   2. the imports make a dependency graph which gets sorted topologically (and a cycle is an error)
+//   3. modules are handed to worker threads as soon as everything they import is done, a module is compiled again only
+//      if its source hash changed or the hash over the interfaces of its imports changed, when a recompiled module ends up
+//      with the same interface as before nothing that imports it has to be compiled again
+//   4. the manifest is written back with the new hashes
+// everything lives in .unnbuild next to the entry file (or inside the directory being built)
+
+#ifndef BUILD_H
+#define BUILD_H
+
+#include <pthread.h> // worker threads
+#include "Module.h" // compiling and loading single modules
+
+#define BUILD_DIR ".unnbuild" // directory for the manifest the object files and the interfaces
+#define BUILD_MANIFEST "manifest"
+
+typedef enum { MODULE_WAITING, MODULE_BUILT, MODULE_FAILED } ModuleState;
+
+typedef struct BuildModule {
+        char *path; // canonical path of the source file
+        char **imports; // canonical paths of the imported files in the order they are imported
+        size_t importCount;
+        struct BuildModule **deps; // the modules behind imports
+        struct BuildModule **users; // modules that import this one
+        size_t userCount;
+        size_t userCap;
+        int reachable; // found from the files being built (the rest only came from the manifest)
+        int known; // had a record in the manifest
+        long long mtime; // nanoseconds
+        long long size;
+        unsigned long long sourceHash;
+        unsigned long long interfaceHash;
+        unsigned long long depsHash; // hash over the interface hashes of the imports
+        long long oldMtime; // the same things as they were in the manifest
+        long long oldSize;
+        unsigned long long oldSourceHash;
+        unsigned long long oldInterfaceHash;
+        unsigned long long oldDepsHash;
+        Interface iface; // exports once loaded from the .unni file or compiled
+        int ifaceLoaded;
+        int pending; // imports that are not finished yet
+        ModuleState state;
+} BuildModule;
+
+typedef struct {
+        char *root; // directory the build directory lives in
+        SymbolTable paths; // interns canonical paths so a path id is an index into modules
+        BuildModule **modules;
+        size_t moduleCount;
+        size_t moduleCap;
+        BuildModule **order; // reachable modules sorted so every module comes after the modules it imports
+        size_t orderCount;
+        size_t compiled; // modules that actually got compiled
+        size_t failed;
+        // scheduling
+        BuildModule **queue; // modules whose imports are all finished
+        size_t queueHead;
+        size_t queueTail;
+        size_t remaining; // modules not finished yet
+        pthread_mutex_t lock;
+        pthread_cond_t ready;
+        pthread_mutex_t ifaceLock; // guards loading interfaces of modules that were not compiled
+} Build;
+
+// builds everything reachable from path (a .unn file or a directory holding .unn files) using jobs threads
+// returns 0 when everything is up to date afterwards
+int build_run(Build *build, const char *path, int jobs);
+// loads every module of a finished build into vm and runs their top levels in dependency order, returns like vm_run
+// the bytecode of everything loaded is printed to listing first unless it is NULL
+int build_exec(Build *build, VM *vm, FILE *listing);
+// frees everything build_run allocated
+void build_free(Build *build);
+
+#endif
@@ -0,0 +1,1025 @@
+// here is the compiler that walks the AST and emits register machine bytecode (see Bytecode.h for the encoding)
+//
+// registers are handed out like a stack, local variables take the lowest registers of a frame in the order they are declared
+// and temporaries go right above them and are given back as soon as the expression that needed them is done
+// functions and classes are global and hoisted so they can be used before they are defined, top level variables
+// are locals of the main function so functions cant see them (there are no closures yet), once main has MAX_MAIN_LOCALS
+// of them in registers the rest go into globals under a name no identifier can have so long generated files still fit
+
+#include "Bytecode.h"
+
+#define OPCODE_NAME(name) #name,
+const char *opNames[OP_COUNT] = { OPCODES(OPCODE_NAME) };
+#undef OPCODE_NAME
+
+#define MAX_LOCALS 250 // locals in scope at once in one function
+#define MAX_MAIN_LOCALS 200 // top level variables kept in registers of main the rest leave room for temporaries and loops
+
+typedef struct {
+        int name; // symbol
+        int reg; // register the variable lives in
+        int depth; // scope depth it was declared at
+        int isConst;
+        int global; // global slot of a top level variable that did not get a register or -1
+} Local;
+
+// jumps that have to be patched once the end of a loop is known
+typedef struct Loop {
+        struct Loop *enclosing;
+        size_t *breaks; // positions of break jumps
+        size_t breakCount;
+        size_t *continues; // positions of continue jumps
+        size_t continueCount;
+} Loop;
+
+typedef struct {
+        VM *vm;
+        Function *function;
+        Local locals[MAX_LOCALS];
+        int localCount;
+        Local *globals; // top level variables past MAX_MAIN_LOCALS only main has these
+        int globalCount;
+        int globalCap;
+        int scopeDepth;
+        int freeReg; // first register not used by a local or a live temporary
+        Loop *loop;
+        size_t line; // line of the node being compiled stored next to every instruction
+        size_t col;
+        int isMain; // compiling the top level
+        int outOfRegisters; // running out of registers or locals is only reported the first time
+        int *hadError;
+} Compiler;
+
+int op_width(OpCode op) {
+        switch (op) {
+                case OP_JMPF: case OP_JMPT:
+                case OP_IFLT: case OP_IFLE: case OP_IFEQ: case OP_IFNE:
+                case OP_IFLTK: case OP_IFLEK: case OP_IFGTK: case OP_IFGEK: case OP_IFEQK: case OP_IFNEK:
+                case OP_GETPROP: case OP_SETPROP: case OP_INVOKE:
+                        return 2;
+                default:
+                        return 1;
+        }
+}
+
+// error messages follow the same format as the lexer
+static void compile_error(Compiler *c, const Node *node, const char *format, const char *name) {
+        size_t line = node ? node->line : c->line;
+        size_t col = node ? node->col : c->col;
+        fprintf(error_stream(), "SEMANTIC ERROR: ");
+        fprintf(error_stream(), format, name);
+        fprintf(error_stream(), " \nLINE : %lu, COL : %lu\n", line, col);
+        *c->hadError = 1;
+}
+
+static void set_line(Compiler *c, const Node *node) {
+        if (node) {
+                c->line = node->line;
+                c->col = node->col;
+        }
+}
+
+// dynamic arrays for code constants and caches
+static size_t emit(Compiler *c, uint32_t word) {
+        Function *f = c->function;
+        if (f->codeLen >= f->codeCap) {
+                size_t newCap = f->codeCap ? f->codeCap * 2 : 64;
+                uint32_t *newCode = realloc(f->code, sizeof(uint32_t) * newCap);
+                size_t *newLines = realloc(f->lines, sizeof(size_t) * newCap);
+                if (!newCode || !newLines) {
+                        fprintf(stderr, "SEMANTIC ERROR: Unable to grow bytecode\n");
+                        exit(1);
+                }
+                f->code = newCode;
+                f->lines = newLines;
+                f->codeCap = newCap;
+        }
+        f->code[f->codeLen] = word;
+        f->lines[f->codeLen] = c->line;
+        return f->codeLen++;
+}
+
+static int values_same(Value a, Value b) {
+        if (a.type != b.type) return 0;
+        switch (a.type) {
+                case VAL_INT: return a.as.i == b.as.i;
+                case VAL_DOUBLE: return memcmp(&a.as.d, &b.as.d, sizeof(double)) == 0; // 0.0 and -0.0 have to stay different constants
+                case VAL_STRING: return a.as.string->length == b.as.string->length && memcmp(a.as.string->chars, b.as.string->chars, a.as.string->length) == 0;
+                default: return 0;
+        }
+}
+
+// adds a constant reusing an existing one with the same value
+static int add_constant(Compiler *c, Value value) {
+        Function *f = c->function;
+        for (size_t i = 0; i < f->constCount; i++) {
+                if (values_same(f->constants[i], value)) return (int)i;
+        }
+        if (f->constCount >= 65535) {
+                compile_error(c, NULL, "Too many constants in one function%s", "");
+                return 0;
+        }
+        if (f->constCount >= f->constCap) {
+                size_t newCap = f->constCap ? f->constCap * 2 : 16;
+                Value *newConstants = realloc(f->constants, sizeof(Value) * newCap);
+                if (!newConstants) {
+                        fprintf(stderr, "SEMANTIC ERROR: Unable to grow constant table\n");
+                        exit(1);
+                }
+                f->constants = newConstants;
+                f->constCap = newCap;
+        }
+        f->constants[f->constCount] = value;
+        return (int)f->constCount++;
+}
+
+static int add_cache(Compiler *c, const char *name) {
+        Function *f = c->function;
+        if (f->cacheCount >= f->cacheCap) {
+                size_t newCap = f->cacheCap ? f->cacheCap * 2 : 8;
+                InlineCache *newCaches = realloc(f->caches, sizeof(InlineCache) * newCap);
+                if (!newCaches) {
+                        fprintf(stderr, "SEMANTIC ERROR: Unable to grow inline caches\n");
+                        exit(1);
+                }
+                f->caches = newCaches;
+                f->cacheCap = newCap;
+        }
+        InlineCache *cache = &f->caches[f->cacheCount];
+        cache->name = symbol_intern(c->vm->symbols, name);
+        cache->shape = NULL;
+        cache->slot = -1;
+        cache->transition = NULL;
+        cache->method = NULL;
+        cache->klass = NULL;
+        return (int)f->cacheCount++;
+}
+
+static int alloc_reg(Compiler *c) {
+        if (c->freeReg >= MAX_REGISTERS) {
+                if (!c->outOfRegisters) compile_error(c, NULL, "Expression needs too many registers%s", "");
+                c->outOfRegisters = 1;
+                return MAX_REGISTERS - 1;
+        }
+        int reg = c->freeReg++;
+        if (c->freeReg > c->function->registers) c->function->registers = c->freeReg;
+        return reg;
+}
+
+// wide instructions are followed by an extra word this emits both and returns where the extra word is
+static size_t emit_wide(Compiler *c, uint32_t word, uint32_t extra) {
+        emit(c, word);
+        return emit(c, extra);
+}
+
+// forward jump whose target gets patched in later
+static size_t emit_jump(Compiler *c) {
+        return emit(c, ENCODE_sAx(OP_JMP, 0));
+}
+
+static void patch_jump_to(Compiler *c, size_t at, size_t target) {
+        long offset = (long)target - (long)(at + 1);
+        if (offset < -(1L << 23) || offset >= (1L << 23)) {
+                compile_error(c, NULL, "Jump is too far%s", "");
+                return;
+        }
+        c->function->code[at] = ENCODE_sAx(OP_JMP, (uint32_t)offset & 0xffffff);
+}
+
+// the extra word of a wide branch is just the whole offset
+static void patch_branch_to(Compiler *c, size_t at, size_t target) {
+        c->function->code[at] = (uint32_t)(int32_t)((long)target - (long)(at + 1));
+}
+
+static void emit_jump_back(Compiler *c, size_t target) {
+        size_t at = emit_jump(c);
+        patch_jump_to(c, at, target);
+}
+
+static void begin_scope(Compiler *c) {
+        c->scopeDepth++;
+}
+
+// first register above every local (and above this for methods)
+static int locals_top(const Compiler *c) {
+        return c->localCount ? c->locals[c->localCount - 1].reg + 1 : c->function->isMethod;
+}
+
+static void end_scope(Compiler *c) {
+        c->scopeDepth--;
+        while (c->localCount > 0 && c->locals[c->localCount - 1].depth > c->scopeDepth) c->localCount--;
+        c->freeReg = locals_top(c);
+}
+
+static Local *resolve_local(Compiler *c, const char *name) {
+        int symbol = symbol_find(c->vm->symbols, name);
+        if (symbol < 0) return NULL;
+        for (int i = c->localCount - 1; i >= 0; i--) {
+                if (c->locals[i].name == symbol) return &c->locals[i];
+        }
+        // top level variables in globals are only ever at depth 0 so every register local in scope shadows them
+        for (int i = c->globalCount - 1; i >= 0; i--) {
+                if (c->globals[i].name == symbol) return &c->globals[i];
+        }
+        return NULL;
+}
+
+// a top level variable of main that did not get a register, the value is in the next free register and gets stored
+static Local *declare_global(Compiler *c, const char *name, int symbol, int isConst) {
+        if (c->globalCount >= c->globalCap) {
+                int newCap = c->globalCap ? c->globalCap * 2 : 64;
+                Local *newGlobals = realloc(c->globals, sizeof(Local) * newCap);
+                if (!newGlobals) {
+                        fprintf(stderr, "SEMANTIC ERROR: Unable to grow top level variables\n");
+                        exit(1);
+                }
+                c->globals = newGlobals;
+                c->globalCap = newCap;
+        }
+        char global[MAX_LEXEME_LEN + sizeof(MAIN_VARIABLE_PREFIX)];
+        snprintf(global, sizeof(global), MAIN_VARIABLE_PREFIX "%s", name);
+        Local *local = &c->globals[c->globalCount++];
+        local->name = symbol;
+        local->reg = -1;
+        local->depth = 0;
+        local->isConst = isConst;
+        local->global = vm_global(c->vm, global);
+        emit(c, ENCODE_ABx(OP_SETGLOBAL, c->freeReg, local->global));
+        return local;
+}
+
+// declares a local in the next free register the caller has to be at statement level so that register is right above the locals
+static Local *declare_local(Compiler *c, const Node *node, const char *name, int isConst) {
+        int symbol = symbol_intern(c->vm->symbols, name);
+        for (int i = c->localCount - 1; i >= 0 && c->locals[i].depth == c->scopeDepth; i--) {
+                if (c->locals[i].name == symbol) {
+                        compile_error(c, node, "Variable '%s' is already declared in this scope", name);
+                        return &c->locals[i];
+                }
+        }
+        for (int i = 0; i < c->globalCount && c->scopeDepth == 0; i++) {
+                if (c->globals[i].name == symbol) {
+                        compile_error(c, node, "Variable '%s' is already declared in this scope", name);
+                        return &c->globals[i];
+                }
+        }
+        if (c->isMain && c->scopeDepth == 0 && c->localCount >= MAX_MAIN_LOCALS) return declare_global(c, name, symbol, isConst);
+        if (c->localCount >= MAX_LOCALS) {
+                if (!c->outOfRegisters) compile_error(c, node, "Too many local variables in one function at '%s'", name);
+                c->outOfRegisters = 1;
+                return &c->locals[c->localCount - 1];
+        }
+        Local *local = &c->locals[c->localCount++];
+        local->name = symbol;
+        local->reg = alloc_reg(c);
+        local->depth = c->scopeDepth;
+        local->isConst = isConst;
+        local->global = -1;
+        return local;
+}
+
+static void expr_to(Compiler *c, Node *node, int target);
+static void statement(Compiler *c, Node *node);
+
+// compiles node and returns the register holding its value locals are used in place instead of being copied
+static int expr_any(Compiler *c, Node *node) {
+        if (node->type == NODE_IDENTIFIER) {
+                Local *local = resolve_local(c, node->name);
+                if (local && local->global < 0) return local->reg;
+        }
+        if (node->type == NODE_THIS && c->function->isMethod) return 0;
+        int reg = alloc_reg(c);
+        expr_to(c, node, reg);
+        return reg;
+}
+
+static int is_number(const Node *node) {
+        return node->type == NODE_INT || node->type == NODE_DOUBLE;
+}
+
+static Value literal_value(const Node *node) {
+        Value value;
+        if (node->type == NODE_INT) {
+                value.type = VAL_INT;
+                value.as.i = node->ival;
+        } else {
+                value.type = VAL_DOUBLE;
+                value.as.d = node->dval;
+        }
+        return value;
+}
+
+// returns the constant index of a number literal if it is small enough for a K instruction or -1
+static int k_operand(Compiler *c, const Node *node) {
+        if (!is_number(node)) return -1;
+        int k = add_constant(c, literal_value(node));
+        return k <= MAX_K_OPERAND ? k : -1;
+}
+
+// true and sets *value when node is an int literal that fits in the signed 8 bit C field of ADDI
+static int small_int(const Node *node, int negate, int *value) {
+        if (node->type != NODE_INT) return 0;
+        long long v = negate ? -node->ival : node->ival;
+        if (v < -128 || v > 127) return 0;
+        *value = (int)v;
+        return 1;
+}
+
+static OpCode arith_op(Type type) {
+        switch (type) {
+                case PLUS: case PLUSEQUALS: case INCREMENT: return OP_ADD;
+                case MINUS: case MINUSEQUALS: case DECREMENT: return OP_SUB;
+                case TIMES: case TIMESEQUALS: return OP_MUL;
+                case DIVIDE: case DIVIDEEQUALS: return OP_DIV;
+                case MOD: case MODEQUALS: return OP_MOD;
+                case POWER: return OP_POW;
+                case BAND: case ANDEQUALS: return OP_BAND;
+                case BOR: case OREQUALS: return OP_BOR;
+                case BXOR: case XOREQUALS: return OP_BXOR;
+                case BSLEFT: return OP_SHL;
+                case BSRIGHT: return OP_SHR;
+                case EQUALITY: return OP_EQ;
+                case NOTEQUALS: return OP_NE;
+                case LESS: case GREATER: return OP_LT;
+                case LESSEQUALS: case GREATEREQUALS: return OP_LE;
+                default: return OP_COUNT;
+        }
+}
+
+// emits target = left op right picking the immediate or constant forms when the right side allows it
+static void emit_arith(Compiler *c, OpCode op, int target, int left, Node *right) {
+        int imm;
+        if ((op == OP_ADD && small_int(right, 0, &imm)) || (op == OP_SUB && small_int(right, 1, &imm))) {
+                emit(c, ENCODE_ABC(OP_ADDI, target, left, (uint8_t)imm));
+                return;
+        }
+        if (op >= OP_ADD && op <= OP_MOD) {
+                int k = k_operand(c, right);
+                if (k >= 0) {
+                        emit(c, ENCODE_ABC(OP_ADDK + (op - OP_ADD), target, left, k));
+                        return;
+                }
+        }
+        int mark = c->freeReg;
+        int r = expr_any(c, right);
+        emit(c, ENCODE_ABC(op, target, left, r));
+        c->freeReg = mark;
+}
+
+// compiles a condition and emits a branch that jumps when it is false returning the position of the offset word to patch
+// comparisons turn into the compare and branch superinstructions instead of a compare followed by a JMPF
+static size_t condition_jump(Compiler *c, Node *cond) {
+        int mark = c->freeReg;
+        set_line(c, cond);
+        size_t at;
+
+        if (cond->type == NODE_BINARY && (cond->op == LESS || cond->op == LESSEQUALS || cond->op == GREATER ||
+                                          cond->op == GREATEREQUALS || cond->op == EQUALITY || cond->op == NOTEQUALS)) {
+                int left = expr_any(c, cond->left);
+                int k = k_operand(c, cond->right);
+                if (k >= 0) {
+                        OpCode op;
+                        switch (cond->op) {
+                                case LESS: op = OP_IFLTK; break;
+                                case LESSEQUALS: op = OP_IFLEK; break;
+                                case GREATER: op = OP_IFGTK; break;
+                                case GREATEREQUALS: op = OP_IFGEK; break;
+                                case EQUALITY: op = OP_IFEQK; break;
+                                default: op = OP_IFNEK; break;
+                        }
+                        at = emit_wide(c, ENCODE_ABC(op, left, k, 0), 0);
+                } else {
+                        int right = expr_any(c, cond->right);
+                        switch (cond->op) {
+                                case LESS: at = emit_wide(c, ENCODE_ABC(OP_IFLT, left, right, 0), 0); break;
+                                case LESSEQUALS: at = emit_wide(c, ENCODE_ABC(OP_IFLE, left, right, 0), 0); break;
+                                case GREATER: at = emit_wide(c, ENCODE_ABC(OP_IFLT, right, left, 0), 0); break; // a > b is b < a
+                                case GREATEREQUALS: at = emit_wide(c, ENCODE_ABC(OP_IFLE, right, left, 0), 0); break;
+                                case EQUALITY: at = emit_wide(c, ENCODE_ABC(OP_IFEQ, left, right, 0), 0); break;
+                                default: at = emit_wide(c, ENCODE_ABC(OP_IFNE, left, right, 0), 0); break;
+                        }
+                }
+        } else {
+                int reg = expr_any(c, cond);
+                at = emit_wide(c, ENCODE_ABC(OP_JMPF, reg, 0, 0), 0);
+        }
+        c->freeReg = mark;
+        return at;
+}
+
+// loads a value into a register for an identifier that is not a local (a function class or built in)
+static void load_global(Compiler *c, Node *node, int target) {
+        int slot = vm_find_global(c->vm, node->name);
+        if (slot < 0) {
+                compile_error(c, node, "Unknown identifier '%s'", node->name);
+                return;
+        }
+        emit(c, ENCODE_ABx(OP_GETGLOBAL, target, slot));
+}
+
+// assignment and ++/-- for a local, target is where the value of the whole expression goes or -1 when nobody uses it
+// a top level variable in a global is loaded into a temp worked on there and stored back
+static void assign_local(Compiler *c, Node *node, Local *local, int target) {
+        Node *value = node->right;
+        int mark = c->freeReg;
+        int reg = local->global < 0 ? local->reg : alloc_reg(c);
+        if (local->isConst) compile_error(c, node, "Cannot assign to const variable '%s'", node->left->name);
+        if (local->global >= 0 && !(node->type == NODE_ASSIGN && node->op == EQUAL)) emit(c, ENCODE_ABx(OP_GETGLOBAL, reg, local->global));
+
+        if (node->type == NODE_INCDEC) {
+                if (target >= 0 && (node->flags & NODE_POSTFIX)) emit(c, ENCODE_ABC(OP_MOVE, target, reg, 0));
+                emit(c, ENCODE_ABC(OP_ADDI, reg, reg, (uint8_t)(node->op == INCREMENT ? 1 : -1)));
+                if (target >= 0 && !(node->flags & NODE_POSTFIX)) emit(c, ENCODE_ABC(OP_MOVE, target, reg, 0));
+        } else {
+                if (node->op == EQUAL) expr_to(c, value, reg);
+                else emit_arith(c, arith_op(node->op), reg, reg, value);
+                if (target >= 0 && target != reg) emit(c, ENCODE_ABC(OP_MOVE, target, reg, 0));
+        }
+        if (local->global >= 0) emit(c, ENCODE_ABx(OP_SETGLOBAL, reg, local->global));
+        c->freeReg = mark;
+}
+
+// assignment and ++/-- for obj.name
+static void assign_member(Compiler *c, Node *node, int target) {
+        int mark = c->freeReg;
+        Node *member = node->left;
+        int object = expr_any(c, member->left);
+        int value = alloc_reg(c);
+
+        if (node->type == NODE_ASSIGN && node->op == EQUAL) {
+                expr_to(c, node->right, value);
+        } else {
+                // read modify write goes through the same caches as normal reads and writes
+                emit_wide(c, ENCODE_ABC(OP_GETPROP, value, object, 0), add_cache(c, member->name));
+                if (node->type == NODE_INCDEC) {
+                        if (target >= 0 && (node->flags & NODE_POSTFIX)) emit(c, ENCODE_ABC(OP_MOVE, target, value, 0));
+                        emit(c, ENCODE_ABC(OP_ADDI, value, value, (uint8_t)(node->op == INCREMENT ? 1 : -1)));
+                } else {
+                        emit_arith(c, arith_op(node->op), value, value, node->right);
+                }
+        }
+        emit_wide(c, ENCODE_ABC(OP_SETPROP, object, value, 0), add_cache(c, member->name));
+        if (target >= 0 && !(node->type == NODE_INCDEC && (node->flags & NODE_POSTFIX))) emit(c, ENCODE_ABC(OP_MOVE, target, value, 0));
+        c->freeReg = mark;
+}
+
+static void assignment(Compiler *c, Node *node, int target) {
+        set_line(c, node);
+        Node *left = node->left;
+        if (left->type == NODE_MEMBER) {
+                assign_member(c, node, target);
+                return;
+        }
+        Local *local = resolve_local(c, left->name);
+        if (local) {
+                assign_local(c, node, local, target);
+                return;
+        }
+        if (vm_find_global(c->vm, left->name) >= 0) {
+                compile_error(c, left, "Cannot assign to '%s'", left->name);
+                return;
+        }
+        // x = 2.5 with no let declares x like test.unn does but only as a statement so the register order stays right
+        if (node->type == NODE_ASSIGN && node->op == EQUAL && target < 0 && c->freeReg == locals_top(c)) {
+                int reg = alloc_reg(c);
+                expr_to(c, node->right, reg);
+                c->freeReg = reg;
+                declare_local(c, left, left->name, 0);
+                return;
+        }
+        compile_error(c, left, "Unknown variable '%s' declare it with let first", left->name);
+}
+
+// calls put the callee (or receiver) and the arguments in consecutive registers starting at base
+static void call(Compiler *c, Node *node, int target) {
+        int mark = c->freeReg;
+        int base = alloc_reg(c);
+        int argc = 0;
+        Node *callee = node->left;
+
+        if (callee->type == NODE_MEMBER) expr_to(c, callee->left, base);
+        else expr_to(c, callee, base);
+
+        for (Node *arg = node->right; arg; arg = arg->next) {
+                int reg = alloc_reg(c);
+                expr_to(c, arg, reg);
+                argc++;
+        }
+        if (argc > 255) compile_error(c, node, "Too many arguments%s", "");
+        set_line(c, node);
+        if (callee->type == NODE_MEMBER) emit_wide(c, ENCODE_ABC(OP_INVOKE, base, argc, 0), add_cache(c, callee->name));
+        else emit(c, ENCODE_ABC(OP_CALL, base, argc, 0));
+
+        if (target >= 0 && target != base) emit(c, ENCODE_ABC(OP_MOVE, target, base, 0));
+        c->freeReg = mark;
+}
+
+static void expr_to(Compiler *c, Node *node, int target) {
+        int mark = c->freeReg;
+        set_line(c, node);
+
+        switch (node->type) {
+                case NODE_INT:
+                        if (node->ival >= -32768 && node->ival <= 32767) emit(c, ENCODE_ABx(OP_LOADI, target, (uint16_t)(int16_t)node->ival));
+                        else emit(c, ENCODE_ABx(OP_LOADK, target, add_constant(c, literal_value(node))));
+                        break;
+                case NODE_DOUBLE:
+                        emit(c, ENCODE_ABx(OP_LOADK, target, add_constant(c, literal_value(node))));
+                        break;
+                case NODE_STRING:
+                        emit(c, ENCODE_ABx(OP_LOADK, target, add_constant(c, vm_string(c->vm, node->text, strlen(node->text)))));
+                        break;
+                case NODE_IDENTIFIER: {
+                        Local *local = resolve_local(c, node->name);
+                        if (local && local->global >= 0) {
+                                emit(c, ENCODE_ABx(OP_GETGLOBAL, target, local->global));
+                        } else if (local) {
+                                if (local->reg != target) emit(c, ENCODE_ABC(OP_MOVE, target, local->reg, 0));
+                        } else {
+                                load_global(c, node, target);
+                        }
+                        break;
+                }
+                case NODE_THIS:
+                        if (!c->function->isMethod) compile_error(c, node, "'this' used outside of a method%s", "");
+                        else if (target != 0) emit(c, ENCODE_ABC(OP_MOVE, target, 0, 0));
+                        break;
+                case NODE_BINARY: {
+                        OpCode op = arith_op(node->op);
+                        if (op == OP_COUNT) {
+                                compile_error(c, node, "Unsupported operator%s", "");
+                                break;
+                        }
+                        int reversed = node->op == GREATER || node->op == GREATEREQUALS; // a > b is b < a
+                        int left = expr_any(c, node->left);
+                        if (reversed) {
+                                int right = expr_any(c, node->right);
+                                emit(c, ENCODE_ABC(op, target, right, left));
+                        } else {
+                                emit_arith(c, op, target, left, node->right);
+                        }
+                        break;
+                }
+                case NODE_LOGICAL: {
+                        // a || b is a if a is truthy otherwise b and a && b is a if a is falsy otherwise b
+                        // when target is a local (x = y || x) the left side cannot go straight into it or b would read
+                        // the new value of x instead of the old one so it goes through a temp
+                        int result = target < locals_top(c) ? alloc_reg(c) : target;
+                        expr_to(c, node->left, result);
+                        size_t at = emit_wide(c, ENCODE_ABC(node->op == OR ? OP_JMPT : OP_JMPF, result, 0, 0), 0);
+                        expr_to(c, node->right, result);
+                        patch_branch_to(c, at, c->function->codeLen);
+                        if (result != target) emit(c, ENCODE_ABC(OP_MOVE, target, result, 0));
+                        break;
+                }
+                case NODE_UNARY: {
+                        if (node->op == MINUS && is_number(node->left)) { // fold -5 into a constant
+                                Node folded = *node->left;
+                                folded.ival = -folded.ival;
+                                folded.dval = -folded.dval;
+                                expr_to(c, &folded, target);
+                                break;
+                        }
+                        int operand = expr_any(c, node->left);
+                        emit(c, ENCODE_ABC(node->op == MINUS ? OP_NEG : OP_NOT, target, operand, 0));
+                        break;
+                }
+                case NODE_ASSIGN: case NODE_INCDEC:
+                        assignment(c, node, target);
+                        break;
+                case NODE_CALL:
+                        call(c, node, target);
+                        break;
+                case NODE_MEMBER: {
+                        int object = expr_any(c, node->left);
+                        emit_wide(c, ENCODE_ABC(OP_GETPROP, target, object, 0), add_cache(c, node->name));
+                        break;
+                }
+                default:
+                        compile_error(c, node, "Expected an expression%s", "");
+                        break;
+        }
+        c->freeReg = mark;
+}
+
+// jumps of break and continue get collected and patched when the loop is finished
+static void add_loop_jump(size_t **list, size_t *count, size_t at) {
+        size_t *newList = realloc(*list, sizeof(size_t) * (*count + 1));
+        if (!newList) {
+                fprintf(stderr, "SEMANTIC ERROR: Unable to grow loop jumps\n");
+                exit(1);
+        }
+        *list = newList;
+        (*list)[(*count)++] = at;
+}
+
+static void end_loop(Compiler *c, Loop *loop, size_t continueTarget, size_t breakTarget) {
+        for (size_t i = 0; i < loop->continueCount; i++) patch_jump_to(c, loop->continues[i], continueTarget);
+        for (size_t i = 0; i < loop->breakCount; i++) patch_jump_to(c, loop->breaks[i], breakTarget);
+        free(loop->continues);
+        free(loop->breaks);
+        c->loop = loop->enclosing;
+}
+
+static void block(Compiler *c, Node *first) {
+        begin_scope(c);
+        for (Node *node = first; node; node = node->next) statement(c, node);
+        end_scope(c);
+}
+
+// statements that are not blocks still get their own scope so if (x) let y = 1 doesnt leak y
+static void body(Compiler *c, Node *node) {
+        if (node->type == NODE_BLOCK) block(c, node->body);
+        else block(c, node);
+}
+
+static void let(Compiler *c, Node *node) {
+        // the value is compiled before the name exists so let x = x uses the outer x
+        int reg = alloc_reg(c);
+        if (node->right) expr_to(c, node->right, reg);
+        else emit(c, ENCODE_ABC(OP_LOADNIL, reg, 0, 0));
+        c->freeReg = reg;
+        declare_local(c, node, node->name, node->flags & NODE_CONST);
+}
+
+static void statement(Compiler *c, Node *node) {
+        set_line(c, node);
+        switch (node->type) {
+                case NODE_BLOCK:
+                        block(c, node->body);
+                        break;
+                case NODE_LET:
+                        let(c, node);
+                        break;
+                case NODE_EXPRESSION: {
+                        Node *expr = node->left;
+                        if (expr->type == NODE_ASSIGN || expr->type == NODE_INCDEC) {
+                                assignment(c, expr, -1);
+                        } else if (expr->type == NODE_CALL) {
+                                call(c, expr, -1);
+                        } else {
+                                int reg = alloc_reg(c);
+                                expr_to(c, expr, reg);
+                                c->freeReg = reg;
+                        }
+                        break;
+                }
+                case NODE_IF: {
+                        size_t skip = condition_jump(c, node->cond);
+                        body(c, node->body);
+                        if (node->orelse) {
+                                size_t over = emit_jump(c);
+                                patch_branch_to(c, skip, c->function->codeLen);
+                                body(c, node->orelse);
+                                patch_jump_to(c, over, c->function->codeLen);
+                        } else {
+                                patch_branch_to(c, skip, c->function->codeLen);
+                        }
+                        break;
+                }
+                case NODE_WHILE: {
+                        Loop loop = { c->loop, NULL, 0, NULL, 0 };
+                        size_t start = c->function->codeLen;
+                        size_t exit = condition_jump(c, node->cond);
+                        c->loop = &loop;
+                        body(c, node->body);
+                        emit_jump_back(c, start);
+                        patch_branch_to(c, exit, c->function->codeLen);
+                        end_loop(c, &loop, start, c->function->codeLen);
+                        break;
+                }
+                case NODE_DO: {
+                        Loop loop = { c->loop, NULL, 0, NULL, 0 };
+                        size_t start = c->function->codeLen;
+                        c->loop = &loop;
+                        body(c, node->body);
+                        size_t check = c->function->codeLen;
+                        size_t exit = condition_jump(c, node->cond);
+                        emit_jump_back(c, start);
+                        patch_branch_to(c, exit, c->function->codeLen);
+                        end_loop(c, &loop, check, c->function->codeLen);
+                        break;
+                }
+                case NODE_FOR: {
+                        begin_scope(c);
+                        if (node->init && node->init->type == NODE_LET) let(c, node->init);
+                        else if (node->init) {
+                                Node wrapper = { .type = NODE_EXPRESSION, .token = node->init->token, .line = node->init->line, .col = node->init->col, .left = node->init };
+                                statement(c, &wrapper);
+                        }
+                        Loop loop = { c->loop, NULL, 0, NULL, 0 };
+                        size_t start = c->function->codeLen;
+                        size_t exit = 0;
+                        if (node->cond) exit = condition_jump(c, node->cond);
+                        c->loop = &loop;
+                        body(c, node->body);
+                        size_t step = c->function->codeLen;
+                        if (node->step) {
+                                Node wrapper = { .type = NODE_EXPRESSION, .token = node->step->token, .line = node->step->line, .col = node->step->col, .left = node->step };
+                                statement(c, &wrapper);
+                        }
+                        emit_jump_back(c, start);
+                        if (node->cond) patch_branch_to(c, exit, c->function->codeLen);
+                        end_loop(c, &loop, step, c->function->codeLen);
+                        end_scope(c);
+                        break;
+                }
+                case NODE_BREAK: case NODE_CONTINUE:
+                        if (!c->loop) {
+                                compile_error(c, node, "'%s' used outside of a loop", node->type == NODE_BREAK ? "break" : "continue");
+                                break;
+                        }
+                        if (node->type == NODE_BREAK) add_loop_jump(&c->loop->breaks, &c->loop->breakCount, emit_jump(c));
+                        else add_loop_jump(&c->loop->continues, &c->loop->continueCount, emit_jump(c));
+                        break;
+                case NODE_RETURN:
+                        if (node->right) {
+                                int mark = c->freeReg;
+                                int reg = expr_any(c, node->right);
+                                emit(c, ENCODE_ABC(OP_RETURN, reg, 1, 0));
+                                c->freeReg = mark;
+                        } else {
+                                emit(c, ENCODE_ABC(OP_RETURN, 0, 0, 0));
+                        }
+                        break;
+                case NODE_FUNCTION: case NODE_CLASS:
+                        // these were compiled up front by compile_program only the top level is allowed to have them
+                        if (!c->isMain || c->scopeDepth != 0) compile_error(c, node, "'%s' can only be defined at the top level", node->name);
+                        break;
+                case NODE_IMPORT:
+                        // the build loads imported modules before this one runs so there is nothing to emit
+                        if (!c->isMain || c->scopeDepth != 0) compile_error(c, node, "Imports can only be at the top of a file%s", "");
+                        break;
+                default:
+                        compile_error(c, node, "Unexpected node%s", "");
+                        break;
+        }
+}
+
+static void compiler_init(Compiler *c, VM *vm, Function *function, int *hadError) {
+        c->vm = vm;
+        c->function = function;
+        c->localCount = 0;
+        c->globals = NULL;
+        c->globalCount = 0;
+        c->globalCap = 0;
+        c->scopeDepth = 0;
+        c->freeReg = 0;
+        c->loop = NULL;
+        c->line = 0;
+        c->col = 0;
+        c->isMain = 0;
+        c->outOfRegisters = 0;
+        c->hadError = hadError;
+}
+
+// parameters are the first locals register 0 is this for methods
+static void declare_params(Compiler *c, Node *params) {
+        if (c->function->isMethod) alloc_reg(c);
+        for (Node *param = params; param; param = param->next) {
+                declare_local(c, param, param->name, 0);
+                c->function->arity++;
+        }
+}
+
+static void finish_function(Compiler *c) {
+        emit(c, ENCODE_ABC(OP_RETURN, 0, 0, 0));
+}
+
+static void compile_function(VM *vm, Function *function, Node *node, int *hadError) {
+        Compiler c;
+        compiler_init(&c, vm, function, hadError);
+        set_line(&c, node);
+        declare_params(&c, node->left);
+        block(&c, node->body->body);
+        finish_function(&c);
+}
+
+// field initializers of klass and every class it extends oldest first as this.field = value
+static void field_initializers(Compiler *c, const Node *classNode, Node **classNodes, Class **classes, size_t classCount) {
+        if (classNode->left) {
+                for (size_t i = 0; i < classCount; i++) {
+                        if (strcmp(classNodes[i]->name, classNode->left->name) == 0) {
+                                field_initializers(c, classNodes[i], classNodes, classes, classCount);
+                                break;
+                        }
+                }
+        }
+        for (Node *member = classNode->body; member; member = member->next) {
+                if (member->type != NODE_LET || !member->right) continue;
+                set_line(c, member);
+                int mark = c->freeReg;
+                int value = expr_any(c, member->right);
+                emit_wide(c, ENCODE_ABC(OP_SETPROP, 0, value, 0), add_cache(c, member->name));
+                c->freeReg = mark;
+        }
+}
+
+// finds the init method node for a class looking through parents too
+static Node *find_init(const Node *classNode, Node **classNodes, size_t classCount) {
+        while (classNode) {
+                for (Node *member = classNode->body; member; member = member->next) {
+                        if (member->type == NODE_FUNCTION && strcmp(member->name, "init") == 0) return member;
+                }
+                const Node *parent = NULL;
+                if (classNode->left) {
+                        for (size_t i = 0; i < classCount; i++) {
+                                if (strcmp(classNodes[i]->name, classNode->left->name) == 0) parent = classNodes[i];
+                        }
+                }
+                classNode = parent;
+        }
+        return NULL;
+}
+
+// the constructor a class gets called through runs every field initializer and then the body of init with inits parameters
+static void compile_constructor(VM *vm, Class *klass, Node *classNode, Node **classNodes, Class **classes, size_t classCount, int *hadError) {
+        Compiler c;
+        Node *init = find_init(classNode, classNodes, classCount);
+        compiler_init(&c, vm, klass->constructor, hadError);
+        set_line(&c, classNode);
+        declare_params(&c, init ? init->left : NULL);
+        begin_scope(&c);
+        field_initializers(&c, classNode, classNodes, classes, classCount);
+        end_scope(&c);
+        if (init) block(&c, init->body->body);
+        finish_function(&c);
+}
+
+// the shape of a new object is every field of every parent and then the new fields of this class
+static Shape *class_shape(VM *vm, const Node *classNode, Node **classNodes, size_t classCount) {
+        Shape *shape = vm->rootShape;
+        if (classNode->left) {
+                for (size_t i = 0; i < classCount; i++) {
+                        if (strcmp(classNodes[i]->name, classNode->left->name) == 0) {
+                                shape = class_shape(vm, classNodes[i], classNodes, classCount);
+                                break;
+                        }
+                }
+        }
+        for (Node *member = classNode->body; member; member = member->next) {
+                if (member->type != NODE_LET) continue;
+                int name = symbol_intern(vm->symbols, member->name);
+                if (shape_find(shape, name) < 0) shape = shape_add(shape, name);
+        }
+        return shape;
+}
+
+Function *compile_program(VM *vm, Node *program) {
+        int hadError = 0;
+        size_t classCount = 0, functionCount = 0;
+        for (Node *node = program->body; node; node = node->next) {
+                if (node->type == NODE_CLASS) classCount++;
+                if (node->type == NODE_FUNCTION) functionCount++;
+        }
+        Node **classNodes = malloc(sizeof(Node *) * (classCount + 1));
+        Class **classes = malloc(sizeof(Class *) * (classCount + 1));
+        Node **functionNodes = malloc(sizeof(Node *) * (functionCount + 1));
+        Function **functions = malloc(sizeof(Function *) * (functionCount + 1));
+        if (!classNodes || !classes || !functionNodes || !functions) {
+                fprintf(stderr, "SEMANTIC ERROR: Unable to allocate compiler memory\n");
+                exit(1);
+        }
+
+        // first pass hoists every function and class into a global so they can be used before their definition
+        classCount = functionCount = 0;
+        for (Node *node = program->body; node; node = node->next) {
+                if (node->type != NODE_CLASS && node->type != NODE_FUNCTION) continue;
+                if (vm_find_global(vm, node->name) >= 0) {
+                        fprintf(error_stream(), "SEMANTIC ERROR: '%s' is already defined \nLINE : %lu, COL : %lu\n", node->name, node->line, node->col);
+                        hadError = 1;
+                        continue;
+                }
+                int slot = vm_global(vm, node->name);
+                if (node->type == NODE_FUNCTION) {
+                        Function *function = vm_new_function(vm, node->name);
+                        vm->globals[slot].type = VAL_FUNCTION;
+                        vm->globals[slot].as.function = function;
+                        functionNodes[functionCount] = node;
+                        functions[functionCount++] = function;
+                } else {
+                        Class *klass = vm_new_class(vm, node->name);
+                        vm->globals[slot].type = VAL_CLASS;
+                        vm->globals[slot].as.klass = klass;
+                        classNodes[classCount] = node;
+                        classes[classCount++] = klass;
+                }
+        }
+
+        // second pass links parents builds shapes and compiles methods
+        for (size_t i = 0; i < classCount; i++) {
+                Node *node = classNodes[i];
+                Class *klass = classes[i];
+                if (node->left) {
+                        for (size_t j = 0; j < classCount; j++) {
+                                if (strcmp(classNodes[j]->name, node->left->name) == 0) klass->parent = classes[j];
+                        }
+                        // walking the parent chain catches a class extending itself through other classes
+                        Class *ancestor = klass->parent;
+                        size_t steps = 0;
+                        while (ancestor && steps <= classCount) {
+                                ancestor = ancestor->parent;
+                                steps++;
+                        }
+                        if (!klass->parent || steps > classCount) {
+                                fprintf(error_stream(), "SEMANTIC ERROR: '%s' cannot extend '%s' \nLINE : %lu, COL : %lu\n", node->name, node->left->name,
+                                        node->line, node->col);
+                                hadError = 1;
+                                klass->parent = NULL;
+                        }
+                }
+        }
+        if (!hadError) {
+                for (size_t i = 0; i < classCount; i++) {
+                        Node *node = classNodes[i];
+                        Class *klass = classes[i];
+                        klass->shape = class_shape(vm, node, classNodes, classCount);
+
+                        size_t methodCount = 0;
+                        for (Node *member = node->body; member; member = member->next) methodCount += member->type == NODE_FUNCTION;
+                        klass->methodNames = malloc(sizeof(int) * (methodCount + 1));
+                        klass->methods = malloc(sizeof(Function *) * (methodCount + 1));
+                        if (!klass->methodNames || !klass->methods) {
+                                fprintf(stderr, "SEMANTIC ERROR: Unable to allocate methods\n");
+                                exit(1);
+                        }
+                        for (Node *member = node->body; member; member = member->next) {
+                                if (member->type != NODE_FUNCTION) continue;
+                                Function *method = vm_new_function(vm, member->name);
+                                method->isMethod = 1;
+                                klass->methodNames[klass->methodCount] = method->name;
+                                klass->methods[klass->methodCount++] = method;
+                                compile_function(vm, method, member, &hadError);
+                        }
+                        klass->constructor->isMethod = 1;
+                        klass->constructor->isConstructor = 1;
+                        compile_constructor(vm, klass, node, classNodes, classes, classCount, &hadError);
+                }
+        }
+        for (size_t i = 0; i < functionCount; i++) compile_function(vm, functions[i], functionNodes[i], &hadError);
+
+        // and finally the top level itself
+        Function *main = vm_new_function(vm, "<main>");
+        Compiler c;
+        compiler_init(&c, vm, main, &hadError);
+        c.isMain = 1;
+        int seenCode = 0;
+        for (Node *node = program->body; node; node = node->next) {
+                // imports have to come first so Build.c can find them without lexing the whole file
+                if (node->type == NODE_IMPORT && seenCode) compile_error(&c, node, "Imports have to come before everything else%s", "");
+                seenCode |= node->type != NODE_IMPORT;
+                statement(&c, node);
+        }
+        finish_function(&c);
+        free(c.globals);
+
+        free(classNodes);
+        free(classes);
+        free(functionNodes);
+        free(functions);
+        return hadError ? NULL : main;
+}
+
+static void print_constant(FILE *out, Value value) {
+        if (value.type == VAL_STRING) fprintf(out, "\"%s\"", value.as.string->chars);
+        else print_value(out, value);
+}
+
+void disassemble(VM *vm, const Function *function, FILE *out) {
+        fprintf(out, "== %s (arity %d, registers %d, constants %zu, caches %zu) ==\n", symbol_name(vm->symbols, function->name),
+                function->arity, function->registers, function->constCount, function->cacheCount);
+        for (size_t i = 0; i < function->codeLen; i += op_width(OP(function->code[i]))) {
+                uint32_t ins = function->code[i];
+                OpCode op = OP(ins);
+                fprintf(out, "%5zu  line %-4lu %-10s", i, function->lines[i], opNames[op]);
+                switch (op) {
+                        case OP_LOADI: fprintf(out, "R%d %d", ARG_A(ins), ARG_sBx(ins)); break;
+                        case OP_LOADK: fprintf(out, "R%d K%u ; ", ARG_A(ins), ARG_Bx(ins)); print_constant(out, function->constants[ARG_Bx(ins)]); break;
+                        case OP_LOADNIL: fprintf(out, "R%d", ARG_A(ins)); break;
+                        case OP_GETGLOBAL: case OP_SETGLOBAL: fprintf(out, "R%d G%u ; %s", ARG_A(ins), ARG_Bx(ins), symbol_name(vm->symbols, vm->globalNames[ARG_Bx(ins)])); break;
+                        case OP_ADDK: case OP_SUBK: case OP_MULK: case OP_DIVK: case OP_MODK:
+                                fprintf(out, "R%d R%d K%d ; ", ARG_A(ins), ARG_B(ins), ARG_C(ins));
+                                print_constant(out, function->constants[ARG_C(ins)]);
+                                break;
+                        case OP_ADDI: fprintf(out, "R%d R%d %d", ARG_A(ins), ARG_B(ins), ARG_sC(ins)); break;
+                        case OP_MOVE: case OP_NEG: case OP_NOT: fprintf(out, "R%d R%d", ARG_A(ins), ARG_B(ins)); break;
+                        case OP_JMP: fprintf(out, "-> %ld", (long)i + 1 + ARG_sAx(ins)); break;
+                        case OP_JMPF: case OP_JMPT: fprintf(out, "R%d -> %ld", ARG_A(ins), (long)i + 2 + (int32_t)function->code[i + 1]); break;
+                        case OP_IFLT: case OP_IFLE: case OP_IFEQ: case OP_IFNE:
+                                fprintf(out, "R%d R%d else -> %ld", ARG_A(ins), ARG_B(ins), (long)i + 2 + (int32_t)function->code[i + 1]);
+                                break;
+                        case OP_IFLTK: case OP_IFLEK: case OP_IFGTK: case OP_IFGEK: case OP_IFEQK: case OP_IFNEK:
+                                fprintf(out, "R%d K%d else -> %ld ; ", ARG_A(ins), ARG_B(ins), (long)i + 2 + (int32_t)function->code[i + 1]);
+                                print_constant(out, function->constants[ARG_B(ins)]);
+                                break;
+                        case OP_GETPROP: case OP_SETPROP: case OP_INVOKE:
+                                fprintf(out, "R%d %s%d .%s", ARG_A(ins), op == OP_INVOKE ? "argc " : "R", ARG_B(ins),
+                                        symbol_name(vm->symbols, function->caches[function->code[i + 1]].name));
+                                break;
+                        case OP_CALL: fprintf(out, "R%d argc %d", ARG_A(ins), ARG_B(ins)); break;
+                        case OP_RETURN: fprintf(out, ARG_B(ins) ? "R%d" : "", ARG_A(ins)); break;
+                        default: fprintf(out, "R%d R%d R%d", ARG_A(ins), ARG_B(ins), ARG_C(ins)); break;
+                }
+                fprintf(out, "\n");
+        }
+}
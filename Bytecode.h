@@ -0,0 +1,78 @@
+// this is the header for the bytecode the compiler turns the AST into instructions for a register machine
+//
+// every instruction is one 32 bit word   | C (8) | B (8) | A (8) | op (8) |
+// A B and C are register numbers (or a constant index for the K instructions), Bx is B and C together as one
+// unsigned 16 bit number and sAx is A B and C together as one signed 24 bit number
+// branches and property accesses are "wide" and have a second word after them holding the jump offset or the inline cache index
+// jump offsets are counted in words from the instruction after the jump (after the extra word for wide ones)
+
+#ifndef BYTECODE_H
+#define BYTECODE_H
+
+#include "Parser.h" // AST
+#include "VM.h" // functions values and classes
+
+// list of every opcode used to build the enum the names for the profiler and disassembler and the computed goto table
+// so they can never get out of order with each other
+#define OPCODES(X) \
+        X(MOVE)      /* R[A] = R[B] */ \
+        X(LOADI)     /* R[A] = sBx small ints dont need the constant table */ \
+        X(LOADK)     /* R[A] = K[Bx] */ \
+        X(LOADNIL)   /* R[A] = nil */ \
+        X(GETGLOBAL) /* R[A] = G[Bx] */ \
+        X(SETGLOBAL) /* G[Bx] = R[A] only top level variables that did not get a register of main */ \
+        X(ADD) X(SUB) X(MUL) X(DIV) X(MOD) X(POW) /* R[A] = R[B] op R[C] */ \
+        X(ADDK) X(SUBK) X(MULK) X(DIVK) X(MODK)   /* R[A] = R[B] op K[C] */ \
+        X(ADDI)      /* R[A] = R[B] + sC superinstruction for x++ x-- x += 1 and x + 1 */ \
+        X(BAND) X(BOR) X(BXOR) X(SHL) X(SHR)      /* R[A] = R[B] op R[C] ints only */ \
+        X(EQ) X(NE) X(LT) X(LE)                   /* R[A] = R[B] op R[C] as 0 or 1 */ \
+        X(NEG)       /* R[A] = -R[B] */ \
+        X(NOT)       /* R[A] = !R[B] */ \
+        X(JMP)       /* pc += sAx */ \
+        X(JMPF)      /* wide: if R[A] is falsy pc += offset */ \
+        X(JMPT)      /* wide: if R[A] is truthy pc += offset */ \
+        X(IFLT) X(IFLE) X(IFEQ) X(IFNE)           /* wide superinstructions: compare R[A] with R[B] and jump when the comparison is false */ \
+        X(IFLTK) X(IFLEK) X(IFGTK) X(IFGEK) X(IFEQK) X(IFNEK) /* wide superinstructions: same but against the number K[B] */ \
+        X(GETPROP)   /* wide: R[A] = R[B].name name and cache come from the cache index in the second word */ \
+        X(SETPROP)   /* wide: R[A].name = R[B] */ \
+        X(INVOKE)    /* wide: R[A] = R[A].name(R[A+1] .. R[A+B]) the receiver becomes this */ \
+        X(CALL)      /* R[A] = R[A](R[A+1] .. R[A+B]) */ \
+        X(RETURN)    /* return R[A] if B is 1 otherwise nil */
+
+#define OPCODE_ENUM(name) OP_##name,
+typedef enum {
+        OPCODES(OPCODE_ENUM)
+        OP_COUNT,
+} OpCode;
+#undef OPCODE_ENUM
+
+// decoding the fields of an instruction word
+#define OP(i) ((i) & 0xff)
+#define ARG_A(i) (((i) >> 8) & 0xff)
+#define ARG_B(i) (((i) >> 16) & 0xff)
+#define ARG_C(i) (((i) >> 24) & 0xff)
+#define ARG_Bx(i) ((i) >> 16)
+#define ARG_sBx(i) ((int)(int16_t)((i) >> 16))
+#define ARG_sC(i) ((int)(int8_t)((i) >> 24))
+#define ARG_sAx(i) ((int)((int32_t)(i) >> 8))
+
+// encoding them
+#define ENCODE_ABC(op, a, b, c) ((uint32_t)(op) | ((uint32_t)(a) << 8) | ((uint32_t)(b) << 16) | ((uint32_t)(c) << 24))
+#define ENCODE_ABx(op, a, bx) ((uint32_t)(op) | ((uint32_t)(a) << 8) | ((uint32_t)(bx) << 16))
+#define ENCODE_sAx(op, ax) ((uint32_t)(op) | ((uint32_t)(ax) << 8))
+
+#define MAX_REGISTERS 250 // registers a single function can use (8 bit register fields)
+#define MAX_K_OPERAND 255 // constants above this cant be used directly by the K instructions
+#define MAIN_VARIABLE_PREFIX "<main>:" // in front of the global name of a top level variable kept in a global
+
+// names of the opcodes for the profiler and the disassembler
+extern const char *opNames[OP_COUNT];
+
+// 2 for wide instructions 1 for everything else
+int op_width(OpCode op);
+// compiles a parsed program returns the main function or NULL after printing the errors
+Function *compile_program(VM *vm, Node *program);
+// prints the instructions of a function in a readable form used by --disasm
+void disassemble(VM *vm, const Function *function, FILE *out);
+
+#endif
@@ -0,0 +1,104 @@
+// this is the thin client for the compile server (see Server.h) it hands its working directory its arguments and its
+// stdin stdout and stderr to the server and exits with whatever status the request ended with
+//
+// usage: ./unn-client [--socket path] [anything ./unn takes]
+//        ./unn-client --stats      print how many files the server has cached
+//        ./unn-client --shutdown   stop the server
+//
+// build: gcc -O2 Client.c -o unn-client   (start the server with ./unn --server [socket])
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h> // PATH_MAX for getcwd
+#include <stdint.h>
+#include "Server.h" // the request format
+
+int main(int argc, char **argv) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        const char *runtime = getenv("XDG_RUNTIME_DIR");
+        int first = 1, len;
+        if (argc > 2 && strcmp(argv[1], "--socket") == 0) {
+                len = snprintf(address.sun_path, sizeof(address.sun_path), "%s", argv[2]);
+                first = 3;
+        } else if (runtime && runtime[0]) len = snprintf(address.sun_path, sizeof(address.sun_path), "%s/%s", runtime, SERVER_SOCKET_NAME);
+        else len = snprintf(address.sun_path, sizeof(address.sun_path), SERVER_SOCKET_FALLBACK, (unsigned)getuid());
+        if (len < 0 || (size_t)len >= sizeof(address.sun_path)) {
+                fprintf(stderr, "CLIENT ERROR: Socket path is too long\n");
+                return 1;
+        }
+
+        // the working directory and every argument each ending in '\0'
+        char cwd[PATH_MAX];
+        if (!getcwd(cwd, sizeof(cwd))) {
+                perror("CLIENT ERROR: getcwd");
+                return 1;
+        }
+        size_t length = strlen(cwd) + 1;
+        for (int i = first; i < argc; i++) length += strlen(argv[i]) + 1;
+        if (length > SERVER_MAX_REQUEST) {
+                fprintf(stderr, "CLIENT ERROR: Too many arguments\n");
+                return 1;
+        }
+        char *payload = malloc(length), *at = payload;
+        if (!payload) return 1;
+        memcpy(at, cwd, strlen(cwd) + 1);
+        at += strlen(cwd) + 1;
+        for (int i = first; i < argc; i++) {
+                memcpy(at, argv[i], strlen(argv[i]) + 1);
+                at += strlen(argv[i]) + 1;
+        }
+
+        int server = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (server < 0 || connect(server, (struct sockaddr *)&address, sizeof(address)) != 0) {
+                fprintf(stderr, "CLIENT ERROR: No server on '%s' start one with ./unn --server\n", address.sun_path);
+                return 1;
+        }
+
+        // the header carries our stdin stdout and stderr so the server writes straight to them
+        uint32_t header[2] = {SERVER_MAGIC, (uint32_t)length};
+        int fds[3] = {0, 1, 2};
+        union {
+                char buffer[CMSG_SPACE(sizeof(fds))];
+                struct cmsghdr align;
+        } control;
+        memset(&control, 0, sizeof(control));
+        struct iovec io = {header, sizeof(header)};
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+        int ok = sendmsg(server, &message, 0) == (ssize_t)sizeof(header);
+        for (size_t sent = 0; ok && sent < length;) {
+                ssize_t wrote = write(server, payload + sent, length - sent);
+                if (wrote < 0 && errno == EINTR) continue;
+                ok = wrote > 0;
+                if (ok) sent += (size_t)wrote;
+        }
+        free(payload);
+
+        int32_t status = 0;
+        size_t got = 0;
+        while (ok && got < sizeof(status)) {
+                ssize_t n = read(server, (char *)&status + got, sizeof(status) - got);
+                if (n < 0 && errno == EINTR) continue;
+                ok = n > 0;
+                if (ok) got += (size_t)n;
+        }
+        close(server);
+        if (!ok) {
+                fprintf(stderr, "CLIENT ERROR: Lost the server\n");
+                return 1;
+        }
+        return status;
+}
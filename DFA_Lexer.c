@@ -1,34 +1,6 @@
 // here is my implementation of a lexer using DFA
 
-#include <stdio.h> // standard i/o lib for C
-#include <stdlib.h> // standard lib for C
-#include <ctype.h> // lib for char type functions like isdigit()
-#include <string.h> // lib for string functions like strcmp()
-
-#define MAX_LEXEME_LEN 1024 // maximum length for lexeme
-#define TOKEN_STREAM_LEN 10 // initial stream length
-
-//type definition using enum to valuate type in a readable way
-typedef enum {
-        IF, ELSE, VOID, CASE, DEFAULT, BREAK, CONTINUE, WHILE, FOR, DO, RETURN, CONST, LET, VAR, DEFINE, CLASS, OBJECT, THIS, SUPER, EXTENDS, IMPLEMENTS, INTERFACE, TRY, CATCH, FINALLY, THROW, PUBLIC, PRIVATE, PROTECTED, STATIC, FINAL, IMPORT, EXPORT, ASYNC, AWAIT,
-        IDENTIFIER,
-        // operators 1st order
-        PLUS, MINUS, TIMES, DIVIDE, MOD, LESS, GREATER, BOR, BAND, BXOR, NEGATION, EQUAL, 
-        // second order        
-        INCREMENT, DECREMENT, POWER, SLCOMMENT, DOUBLEMOD, BSLEFT, BSRIGHT, OR, AND, EXP, DOUBLENEGATION, EQUALITY, 
-        // third order
-        PLUSEQUALS, MINUSEQUALS, TIMESEQUALS, DIVIDEEQUALS, MODEQUALS, LESSEQUALS, GREATEREQUALS, OREQUALS, ANDEQUALS, XOREQUALS, NOTEQUALS,
-        SEMI, COMMA, OPENP, CLOSEP, OPENC, CLOSEC, OPENB, CLOSEB,
-        INT, DOUBLE, STRING,
-        UNKNOWN, INVALID,
-} Type;
-// token structure consisting of a Type and string for the actual value of the token
-typedef struct {
-        Type type;
-        char lexeme[MAX_LEXEME_LEN];
-        size_t line;
-        size_t col;
-} Token;
+#include "DFA_Lexer.h" // token types trie and lexer declarations shared with the parser
 
 char *strdup(const char *c)
 {
@@ -39,19 +11,17 @@ char *strdup(const char *c)
         return dup;
 }
 
-typedef struct TrieNode {
-        char *value; // Value of the node (substring)
-        int isEnd; // Indicates if this node marks the end of a word
-        struct TrieNode **children; // Array of child nodes
-        int childCount; // Number of children
-        Type type; // Type associated with the node
-} TrieNode;
+_Thread_local FILE *errorStream = NULL;
+
+FILE *error_stream(void) {
+        return errorStream ? errorStream : stderr;
+}
 
 // simple initialization of trie node setting it to empty values and creating new memory space
 TrieNode *createNode(const char *word, Type type) {
         TrieNode *node = malloc(sizeof(TrieNode));
         if (!node) {
-                fprintf(stderr, "LEXICAL ERROR: Unable to allocate trie memory\n");
+                fprintf(error_stream(), "LEXICAL ERROR: Unable to allocate trie memory\n");
                 return NULL;
         }
         node->value = strdup(word);
@@ -101,7 +71,8 @@ void insert(TrieNode **root, const char *word, Type type) {
                 if (len == strlen(current->value)) {
                         // Current node matches prefix
                         if (len == strlen(word)) {
-                                current->isEnd = 1; // Word already exists
+                                current->isEnd = 1; // Word already exists or ends on a node made by an earlier split
+                                current->type = type;
                                 return;
                         }
                         // set found child to 0 and look for child in below loop if common prefix is not found create new
@@ -151,7 +122,11 @@ void insert(TrieNode **root, const char *word, Type type) {
                         // now handling the new word by checking if there is any remainder or if the common prefix is the end of the word such as append as existing and appending as the new insertion word
                         // we would need a new node for the ing
                         // this will pretty much always be called unless inserting a word that already exists
-                        if (strlen(word) > len) {
+                        if (strlen(word) == len) {
+                                // the new word ends exactly on the split like inserting final after finally so this node is now an end
+                                current->isEnd = 1;
+                                current->type = type;
+                        } else {
                                 TrieNode *newChild = createNode(word + len, type); // creating a new node for the ending that does not exist
                                 newChild->isEnd = 1; // setting it to an end node so we know that the word is a match if we make it here
                                 current->children = realloc(current->children, sizeof(TrieNode*) * (current->childCount + 1)); // adding memory for the new child node
@@ -175,9 +150,9 @@ Type search(TrieNode *root, const char *word) {
                 // if the two words match
                 if (len == strlen(current->value)) {
 
-                        // Check if we've reached the end of the word
+                        // Check if we've reached the end of the word only end nodes are keywords so i stops being read as if
                         if (len == strlen(word)) {
-                                return current->type; // Found the exact match
+                                return current->isEnd ? current->type : IDENTIFIER; // Found the exact match
                         }
 
                         // Move to the next child node
@@ -203,7 +178,7 @@ Type search(TrieNode *root, const char *word) {
 }
 
 Token operators(char *current) {
-        Token token = {UNKNOWN, "", 0, 0};
+        Token token = { .type = UNKNOWN, .lexeme = "" };
         int len = 1;
 
         // def type of corresponding comp op so long as the order of the operators doesnt change it should work
@@ -221,7 +196,7 @@ Token operators(char *current) {
                 case '>': token.type = GREATER; break;
                 case '|': token.type = BOR; break;
                 case '&': token.type = BAND; break;
-                case '^': token.type = BOR; break;
+                case '^': token.type = BXOR; break;
                 default: return token;
         }
         // incrementing pointer to compare the previous value identified by the type against the following
@@ -232,7 +207,7 @@ Token operators(char *current) {
         // adding 7 to PLUS gives increments and adding 7 to EQUALS gives EQUALITY so on and so forth so we just check for if the current and next token are equal if so we dont change anything since 7 has already been
         // added otherwise we check if its an equal which adds another 7 so PLUS would become INCREMENT and with the presence of an = after it another 7 would be added giving PLUSEQUALS in the event of a +=
         // if none of those checks are entered than its a standalone value and we return the original result of the switch statement and change len to 1 for proper lexeme printing
-        if (*current == '\0') return token;
+        // an operator right at the end of the file ('\0' after it) falls through to the single operator case below
         // starting with the simpler operation deciding weather
         if (c == *current) len = 2;
         // im too lazy right now to compact this logic so dont be suprised if its in the final copy
@@ -244,22 +219,16 @@ Token operators(char *current) {
         }
         // if we've made it to the end after all of that its a single operator
         token.type = token.type;
-        if  (token.type == SLCOMMENT) {
-                char *new = current;
-                while (*new != '\n' && *new != '\0') {
-                        len++;
-                        new++;
-                }
-        }
         strncpy(token.lexeme, current - 1, len); // set the lexeme from current - 1 to adjust for incrementation earlier for check
         token.lexeme[len] = '\0';
+        token.length = (size_t)len;
 
         return token;
 }
 
 // this should be pretty self explanitory
 Token seperator(char *current) {
-        Token token = {UNKNOWN, "", 0, 0};
+        Token token = { .type = UNKNOWN, .lexeme = "" };
         // just a simple switch statement for finding weather current is a seperator nothing too special
         switch (*current) {
                 case ';': token.type = SEMI; token.lexeme[0] = ';'; break;
@@ -270,9 +239,11 @@ Token seperator(char *current) {
                 case '}': token.type = CLOSEC; token.lexeme[0] = '}'; break;
                 case '[': token.type = OPENB; token.lexeme[0] = '['; break;
                 case ']': token.type = CLOSEB; token.lexeme[0] = ']'; break;
+                case '.': token.type = DOT; token.lexeme[0] = '.'; break; // member access like point.x
                 default: return token;
         }
         token.lexeme[1] = '\0';
+        token.length = 1;
         // update current becuase the main funtion does not
         return token;
 }
@@ -280,7 +251,7 @@ Token seperator(char *current) {
 // Identifier state machine see notes in DFA Images branch of this repository to see how I got this or just sift through the logic its not too complicated
 Token identifier(char *current) {
         int index = 0, state = 1; // initial state
-        Token token = {UNKNOWN, "", 0, 0};
+        Token token = { .type = UNKNOWN, .lexeme = "" };
         token.lexeme[0] = '\0';
 
         while (*current != '\0') {
@@ -289,6 +260,7 @@ Token identifier(char *current) {
 
                 switch (state) { // here the Φ state simply represents returning an UNKNOWN type to transition to this state we will simply set state to 0
                         case 0:
+                                token.length = (size_t)index;
                                 return token;
                         case 1:
                                 if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_') state = 2; // set a as denoted in the regex to nfa ab*
@@ -298,17 +270,19 @@ Token identifier(char *current) {
                                 if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c<= '9') || c == '_')) state = 0;
                                 break;
                 }
-                token.lexeme[index++] = c;
+                if (index < MAX_LEXEME_LEN - 1) token.lexeme[index] = c; // past that the token is still scanned just not kept
+                index++;
                 current++;
         }
-        token.lexeme[index] = '\0';
+        token.lexeme[index < MAX_LEXEME_LEN - 1 ? index : MAX_LEXEME_LEN - 1] = '\0';
+        token.length = (size_t)index;
         token.type = (state == 2 ? IDENTIFIER : INVALID);
         return token;
 }
 
 // Number DFA Logic same thing as the Identifier state machine see DFA Images branch for notes or just logic your way through
 Token number(char *current) {
-        Token token = {UNKNOWN, "", 0, 0};
+        Token token = { .type = UNKNOWN, .lexeme = "" };
 
         int state = 1;
         int decicount = 0; // for Identifying weather its a decimal or integer and weather its a valid number without ending the loop early
@@ -340,11 +314,13 @@ Token number(char *current) {
                                 else state = 0;
                                 break;
                 }
-                token.lexeme[index++] = c;
+                if (index < MAX_LEXEME_LEN - 1) token.lexeme[index] = c; // past that the token is still scanned just not kept
+                index++;
                 current++;
         }
         // if were here the format is valid
-        token.lexeme[index] = '\0';
+        token.lexeme[index < MAX_LEXEME_LEN - 1 ? index : MAX_LEXEME_LEN - 1] = '\0';
+        token.length = (size_t)index;
         if (state == 2) { // checking if it ended on a valid state
                 token.type = decicount > 1 ? UNKNOWN : (decicount == 0) ? INT : DOUBLE;
         }
@@ -353,7 +329,7 @@ Token number(char *current) {
 
 // string literal DFA once again check DFA Images for notes on how I came up with this it would also help to read the lexical analysis test file for more info or just logic through it
 Token string(char *current) {
-        Token token = { STRING, "", 0, 0 };
+        Token token = { .type = STRING, .lexeme = "" };
         int state = 1;
         int index = 0;
 
@@ -368,17 +344,17 @@ Token string(char *current) {
                         case 4: if (c == '"') state = 5; else state = 0; break;
                         case 5: break;
                 }
-                token.lexeme[index++] = c;
+                if (index < MAX_LEXEME_LEN - 1) token.lexeme[index] = c; // past that the token is still scanned just not kept
+                index++;
                 current++;
         }
-        token.lexeme[index] = '\0';
+        token.lexeme[index < MAX_LEXEME_LEN - 1 ? index : MAX_LEXEME_LEN - 1] = '\0';
+        token.length = (size_t)index;
         return token;
 }
 
-// Main lexing method
-Token *lexer_main(char *input) {
-        Token token = {UNKNOWN, "", 0, 0};
-        Token *tokens = malloc(sizeof(Token) * TOKEN_STREAM_LEN);
+// builds the keyword trie that lexer_run looks identifiers up in
+TrieNode *lexer_keywords(void) {
         TrieNode *root = createNode("", UNKNOWN);
 
         // inserting all of our keywords into the trie adds some overhead but imporves string comparison time for large wordsets which i plan on making this could be compacted with a keyword string array that maps
@@ -419,26 +395,108 @@ Token *lexer_main(char *input) {
         insert(&root, "export", EXPORT);
         insert(&root, "async", ASYNC);
         insert(&root, "await", AWAIT);
+        return root;
+}
 
-        // actual logic down here
-        if (!tokens) { // just error handling
-                perror("Error initializing token length");
-                return NULL;
+// Main lexing method
+Token *lexer_main(char *input, size_t *count) {
+        TrieNode *root = lexer_keywords();
+        Token *tokens = lexer_run(input, count, root);
+        freeTrie(root);
+        return tokens;
+}
+
+void lexer_init(Lexer *lexer, char *input, TrieNode *keywords) {
+        lexer->input = input;
+        lexer->current = input;
+        lexer->line = 1;
+        lexer->col = 1;
+        lexer->keywords = keywords;
+        lexer->stripComments = 0;
+        lexer->trivia = NULL;
+        lexer->tokens = 0;
+        lexer->more = 0;
+        lexer->commentScanned = 0;
+#ifdef LEXER_DEBUG
+        printf("CURRENT INITIAL : %s", input);
+#endif
+}
+
+void lexer_strip(Lexer *lexer, TriviaTable *trivia) {
+        lexer->stripComments = 1;
+        lexer->trivia = trivia;
+}
+
+void trivia_init(TriviaTable *table) {
+        memset(table, 0, sizeof(TriviaTable));
+}
+
+void trivia_free(TriviaTable *table) {
+        free(table->items);
+        free(table->text);
+        trivia_init(table);
+}
+
+// copies the text into the table, a run that does not fit in memory is left out with an error
+static void trivia_add(TriviaTable *table, TriviaKind kind, size_t token, const char *text, size_t length) {
+        // whitespace that got split between two pieces of input (see lexer_next) goes on the end of the run it continues
+        Trivia *last = table->count ? &table->items[table->count - 1] : NULL;
+        int extend = kind == TRIVIA_SPACE && last && last->kind == TRIVIA_SPACE && last->token == token && last->text + last->length == table->length;
+        if (!extend && table->count >= table->cap) {
+                size_t cap = table->cap ? table->cap * 2 : TOKEN_STREAM_LEN;
+                Trivia *items = realloc(table->items, sizeof(Trivia) * cap);
+                if (!items) {
+                        perror("Error reallocating trivia");
+                        return;
+                }
+                table->items = items;
+                table->cap = cap;
         }
+        if (table->length + length > table->textCap) {
+                size_t cap = table->textCap ? table->textCap : 256;
+                while (cap < table->length + length) cap *= 2;
+                char *grown = realloc(table->text, cap);
+                if (!grown) {
+                        perror("Error reallocating trivia");
+                        return;
+                }
+                table->text = grown;
+                table->textCap = cap;
+        }
+        memcpy(table->text + table->length, text, length);
+        if (extend) last->length += length;
+        else table->items[table->count++] = (Trivia){kind, token, table->length, length};
+        table->length += length;
+}
 
-        // initializing variables
-        size_t cap = TOKEN_STREAM_LEN;
-        size_t index = 0, line = 1, col = 1;
-        char *current = input;
+// same as comment_length but the first from characters are already known not to end the comment
+static size_t comment_scan(const char *current, size_t from, int *closed) {
+        const char *end = current + (from > 2 ? from : 2);
+        *closed = 1;
+        if (current[1] == '/') {
+                while (*end != '\n' && *end != '\0') end++;
+        } else {
+                while (*end != '\0' && !(end[0] == '*' && end[1] == '/')) end++;
+                if (*end == '\0') *closed = 0;
+                else end += 2;
+        }
+        return (size_t)(end - current);
+}
 
-        printf("CURRENT INITIAL : %s", current);
+// length of the // or /* comment at current, closed is 0 when a block comment runs into the end of the file
+size_t comment_length(const char *current, int *closed) {
+        return comment_scan(current, 2, closed);
+}
 
-        // start of the while loop
-        while (*current != '\0') {
-                token.type = UNKNOWN;
-                token.lexeme[0] = '\0';
+int lexer_next(Lexer *lexer, Token *token) {
+        char *current = lexer->current;
+        size_t line = lexer->line, col = lexer->col;
+        token->type = UNKNOWN;
+        token->lexeme[0] = '\0';
 
-                // skip over whitespace
+        // whitespace and comments in front of the token, comments are only a token themselves when they are not stripped
+        while (1) {
+                char *start = current;
                 while (isspace(*current)) {
                         if (*current == '\n') {
                                 col = 0;
@@ -447,31 +505,137 @@ Token *lexer_main(char *input) {
                         current++;
                         col++;
                 }
-                printf("CURRENT CHAR : %c\n", *current);
-
-                // Tokenizing Logic calls
-                if (*current == '"') {
-                        // error handling for invalid strings
-                        token = string(current);
-                        if (token.type == INVALID) fprintf(stderr, "LEXICAL ERROR: Invalid escape attempt : '%s' \nline : %lu, col : %lu\n", token.lexeme, line, col);
-                        if (*current == '\0') fprintf(stderr, "LEXICAL ERROR: reached end of the file while parsing string : '%s' \nline : %lu, col %lu\n", token.lexeme, line, col);
+                if (lexer->trivia && current > start) trivia_add(lexer->trivia, TRIVIA_SPACE, lexer->tokens, start, (size_t)(current - start));
+                // the whitespace is done with even when it goes on in the next piece of input (that just adds to its trivia)
+                // so with more set nothing in front of the token ever gets looked at twice
+                lexer->current = current;
+                lexer->line = line;
+                lexer->col = col;
+                if (*current == '\0' && lexer->more) return -1;
+                if (current[0] != '/' || (current[1] != '/' && current[1] != '*')) break;
+
+                int closed;
+                size_t len = comment_scan(current, lexer->commentScanned, &closed);
+                if (current[len] == '\0' && lexer->more) {
+                        // the comment might go on so it waits, the next call goes on scanning from here instead of from the
+                        // start of the comment (backing up over a '*' that could be the start of the end)
+                        lexer->commentScanned = len - (closed ? 2 : 1);
+                        return -1;
                 }
-                // calling the functions only overwriting if not previously Identified otherwise a valid token could be made unknown and an invalid meant for throwing errors could become unknown
-                if (token.type == UNKNOWN) token = operators(current);
-                if (token.type == UNKNOWN) token = seperator(current);
-                if (token.type == UNKNOWN) token = number(current);
-                if (token.type == UNKNOWN) token = identifier(current);
-                if (token.type == IDENTIFIER) token.type = search(root, token.lexeme);
-                if (token.type == UNKNOWN) current++;
-
-                if (token.type == INVALID) {
-                        // error handling if it makes it through all of that than the token is unrecognized
-                        fprintf(stderr, "LEXICAL ERROR : Unrecognized Token : '%s' \nLINE : %lu, COL : %lu\n", token.lexeme, line, col);
+                lexer->commentScanned = 0;
+                if (!closed) fprintf(error_stream(), "LEXICAL ERROR: reached end of the file while parsing comment \nLINE : %lu, COL : %lu\n", line, col);
+                if (!lexer->stripComments) {
+                        // only as much as fits in a lexeme but the whole comment gets skipped
+                        size_t copy = len < MAX_LEXEME_LEN - 1 ? len : MAX_LEXEME_LEN - 1;
+                        token->type = current[1] == '/' ? SLCOMMENT : MLCOMMENT;
+                        memcpy(token->lexeme, current, copy);
+                        token->lexeme[copy] = '\0';
+                        token->line = line;
+                        token->col = col;
+                        token->offset = (size_t)(current - lexer->input);
+                        token->length = len;
                 }
+                if (lexer->trivia) trivia_add(lexer->trivia, current[1] == '/' ? TRIVIA_LINE_COMMENT : TRIVIA_BLOCK_COMMENT, lexer->tokens, current, len);
+                for (size_t i = 0; i < len; i++, current++) {
+                        if (*current == '\n') {
+                                col = 0;
+                                line++;
+                        }
+                        col++;
+                }
+                if (!lexer->stripComments) {
+                        lexer->current = current;
+                        lexer->line = line;
+                        lexer->col = col;
+                        lexer->tokens++;
+                        return 1;
+                }
+        }
+        // trailing whitespace at the end of the file would otherwise be lexed as an empty token past the null terminator
+        if (*current == '\0') {
+                lexer->current = current;
+                lexer->line = line;
+                lexer->col = col;
+                return 0;
+        }
+        size_t offset = (size_t)(current - lexer->input);
+#ifdef LEXER_DEBUG
+        printf("CURRENT CHAR : %c\n", *current);
+#endif
+
+        // Tokenizing Logic calls
+        if (*current == '"') *token = string(current);
+        // calling the functions only overwriting if not previously Identified otherwise a valid token could be made unknown and an invalid meant for throwing errors could become unknown
+        if (token->type == UNKNOWN) *token = operators(current);
+        if (token->type == UNKNOWN) *token = seperator(current);
+        if (token->type == UNKNOWN) *token = number(current);
+        if (token->type == UNKNOWN) *token = identifier(current);
+        if (token->type == IDENTIFIER) token->type = search(lexer->keywords, token->lexeme);
+
+        // a token that runs into the end of what is there so far might not be finished so nothing gets reported yet, number
+        // and identifier look at every letter digit _ and . in a row even when the token that wins is shorter than that
+        size_t len = token->length;
+        if (lexer->more) {
+                char *scanned = current;
+                while (isalnum((unsigned char)*scanned) || *scanned == '_' || *scanned == '.') scanned++;
+                if (current[len ? len : 1] == '\0' || *scanned == '\0') return -1;
+        }
+        if (*current == '"') {
+                // error handling for invalid strings
+                if (token->type == INVALID) fprintf(error_stream(), "LEXICAL ERROR: Invalid escape attempt : '%s' \nline : %lu, col : %lu\n", token->lexeme, line, col);
+                if (*current == '\0') fprintf(error_stream(), "LEXICAL ERROR: reached end of the file while parsing string : '%s' \nline : %lu, col %lu\n", token->lexeme, line, col);
+        }
+
+        if (len >= MAX_LEXEME_LEN) {
+                // the whole token gets skipped but its value would not fit so it cannot be used
+                fprintf(error_stream(), "LEXICAL ERROR : Token is longer than %d characters : '%.32s...' \nLINE : %lu, COL : %lu\n", MAX_LEXEME_LEN - 1, token->lexeme, line, col);
+                token->type = INVALID;
+        } else if (token->type == INVALID) {
+                // error handling if it makes it through all of that than the token is unrecognized
+                fprintf(error_stream(), "LEXICAL ERROR : Unrecognized Token : '%s' \nLINE : %lu, COL : %lu\n", token->lexeme, line, col);
+        }
+
+        // current pointer incrementation
+        if (len == 0) { token->lexeme[0] = *current; token->lexeme[1] = '\0'; current++; len = token->length = 1; }
+        else current += len;
+
+        // updating column and line in the token for error messages
+        token->line = line;
+        token->col = col;
+        token->offset = offset;
+        col += len;
+
+        // debugging print
+#ifdef LEXER_DEBUG
+        printf("TOKEN AFTER: Type : %d, Lexeme : \'%s\', Line : %lu, Col : %lu\n\n", token->type, token->lexeme, line, col);
+#endif
+        lexer->current = current;
+        lexer->line = line;
+        lexer->col = col;
+        lexer->tokens++;
+        return 1;
+}
+
+// fills a growing array with every token the lexer gives
+static Token *lex_all(Lexer *lexer, size_t *count) {
+        Token *tokens = malloc(sizeof(Token) * TOKEN_STREAM_LEN);
+
+        // actual logic down here
+        if (!tokens) { // just error handling
+                perror("Error initializing token length");
+                return NULL;
+        }
+
+        // initializing variables
+        size_t cap = TOKEN_STREAM_LEN;
+        size_t index = 0;
+
+        // start of the while loop
+        while (1) {
                 // resize token array if capacity is exceeded this is called a dynamic array
                 if (index >= cap) {
-                size_t new_cap = cap * 2;
-                Token *newTokens = realloc(tokens, sizeof(Token) * new_cap);
+                        size_t new_cap = cap * 2;
+                        Token *newTokens = realloc(tokens, sizeof(Token) * new_cap);
                         if (!newTokens) {
                                 perror("Error reallocating tokens");
                                 free(tokens);
@@ -480,26 +644,65 @@ Token *lexer_main(char *input) {
                         tokens = newTokens;
                         cap = new_cap; // Update capacity
                 }
+                if (!lexer_next(lexer, &tokens[index])) break;
+                index++;
+        }
+        // shrinking the array down to the tokens we actually used realloc already frees the old block when it moves it
+        Token *finalTokens = realloc(tokens, sizeof(Token) * (index ? index : 1));
+        if (finalTokens) tokens = finalTokens;
+
+        if (count) *count = index;
+        return tokens;
+}
+
+Token *lexer_run(char *input, size_t *count, TrieNode *root) {
+        Lexer lexer;
+        lexer_init(&lexer, input, root);
+        return lex_all(&lexer, count);
+}
 
-                // current pointer incrementation
-                size_t len = strlen(token.lexeme);
-                if (len == 0) { token.lexeme[0] = *current; current++; }
-                else current += len;
+Token *lexer_run_stripped(char *input, size_t *count, TrieNode *keywords, TriviaTable *trivia) {
+        Lexer lexer;
+        lexer_init(&lexer, input, keywords);
+        lexer_strip(&lexer, trivia);
+        return lex_all(&lexer, count);
+}
+
+// every token goes after the trivia that sits in front of it so this is just merging the two in order
+void lexer_rebuild(FILE *out, const char *source, const Token *tokens, size_t count, const TriviaTable *trivia) {
+        size_t next = 0;
+        for (size_t i = 0; i <= count; i++) {
+                while (trivia && next < trivia->count && trivia->items[next].token <= i) {
+                        fwrite(trivia->text + trivia->items[next].text, 1, trivia->items[next].length, out);
+                        next++;
+                }
+                // the text of a token comes out of the source and not the lexeme so tokens longer than a lexeme come out whole
+                if (i < count) fwrite(source + tokens[i].offset, 1, tokens[i].length, out);
+        }
+}
 
-                // updating column and line in the token for error messages
-                token.line = line;
-                token.col = col;
+// reads a whole source file into a null terminated buffer the same way the drivers always have
+char *read_source(const char *path, size_t *length) {
+        FILE *file = fopen(path, "rb");
+        if (!file) return NULL;
 
-                // debugging print and array adding
-                printf("TOKEN AFTER: Type : %d, Lexeme : \'%s\', Line : %lu, Col : %lu\n\n", token.type, token.lexeme, line, col);
-                tokens[index++] = token;
-                token.type = UNKNOWN;
-                token.lexeme[0] = '\0';
+        fseek(file, 0, SEEK_END); // Go to the end of the file
+        long len = ftell(file); // Get the file size
+        fseek(file, 0, SEEK_SET); // Go back to the start of the file
+        if (len < 0) {
+                fclose(file);
+                return NULL;
         }
-        Token *finalTokens = realloc(tokens, sizeof(Token) * index-1);
-        if (finalTokens) {
-                free(tokens);
-                tokens = finalTokens;
+
+        char *input = malloc((size_t)len + 1);
+        if (!input) {
+                fclose(file);
+                return NULL;
         }
-        return tokens;
+        size_t read = fread(input, 1, (size_t)len, file);
+        input[read] = '\0'; // Null-terminate the string
+        fclose(file);
+
+        if (length) *length = read;
+        return input;
 }
@@ -21,9 +21,10 @@ typedef enum {
         INCREMENT, DECREMENT, POWER, SLCOMMENT, DOUBLEMOD, BSLEFT, BSRIGHT, OR, AND, EXP, DOUBLENEGATION, EQUALITY, 
         // third order
         PLUSEQUALS, MINUSEQUALS, TIMESEQUALS, DIVIDEEQUALS, MODEQUALS, LESSEQUALS, GREATEREQUALS, OREQUALS, ANDEQUALS, XOREQUALS, NOTEQUALS,
-        SEMI, COMMA, OPENP, CLOSEP, OPENC, CLOSEC, OPENB, CLOSEB,
+        SEMI, COMMA, OPENP, CLOSEP, OPENC, CLOSEC, OPENB, CLOSEB, DOT,
         INT, DOUBLE, STRING,
         UNKNOWN, INVALID,
+        MLCOMMENT, // block comments came after the rest so the numbers --tokens prints did not move
 } Type;
 // token structure consisting of a Type and string for the actual value of the token
 typedef struct {
@@ -31,6 +32,8 @@ typedef struct {
         char lexeme[MAX_LEXEME_LEN];
         size_t line;
         size_t col;
+        size_t offset; // byte offset of the first character in the source
+        size_t length; // bytes it covers in the source, a token too long for the lexeme only has the start of it there
 } Token;
 
 typedef struct TrieNode {
@@ -41,6 +44,43 @@ typedef struct TrieNode {
         Type type; // Type associated with the node
 } TrieNode;
 
+// what a piece of trivia is
+typedef enum {
+        TRIVIA_SPACE, TRIVIA_LINE_COMMENT, TRIVIA_BLOCK_COMMENT,
+} TriviaKind;
+
+// a run of whitespace or a comment that got taken out of the token stream
+typedef struct {
+        TriviaKind kind;
+        size_t token; // index of the token right after it (the number of tokens when it is at the end of the file)
+        size_t text; // where its text starts in the table text
+        size_t length;
+} Trivia;
+
+// everything between the tokens in order, the text is kept here so tokens and trivia together give back the source
+typedef struct {
+        Trivia *items;
+        size_t count;
+        size_t cap;
+        char *text; // the text of every item back to back, not null terminated
+        size_t length;
+        size_t textCap;
+} TriviaTable;
+
+// where the lexer is in the input so it can hand out one token at a time instead of building the whole array
+typedef struct {
+        char *input; // start of the source, token offsets count from here
+        char *current; // next character to look at
+        size_t line;
+        size_t col;
+        TrieNode *keywords;
+        int stripComments; // comments never come out as tokens
+        TriviaTable *trivia; // where stripped comments and whitespace go (NULL to just drop them)
+        size_t tokens; // tokens handed out so far so trivia knows which one it sits in front of
+        int more; // the input is only what was read so far (see lexer_next)
+        size_t commentScanned; // with more set how much of the unfinished comment at current was already scanned
+} Lexer;
+
 // simple initialization of trie node setting it to empty values and creating new memory space
 TrieNode *createNode(const char *word, Type type);
 // Function to free children of the trie
@@ -58,7 +98,35 @@ Token identifier(char *current);
 Token number(char *current);
 // string literal DFA once again check DFA Images for notes on how I came up with this it would also help to read the lexical analysis test file for more info or just logic through it
 Token string(char *current);
-// Main lexing method
-Token *lexer_main(char *input);
+// Main lexing method returns the token array and writes the number of tokens into count
+Token *lexer_main(char *input, size_t *count);
+// the keyword trie on its own so something that lexes lots of files (the compile server) can build it once
+TrieNode *lexer_keywords(void);
+// same as lexer_main but with a keyword trie from lexer_keywords
+Token *lexer_run(char *input, size_t *count, TrieNode *keywords);
+// starts lexing input, lexer_next then gives the same tokens lexer_run would one after another
+void lexer_init(Lexer *lexer, char *input, TrieNode *keywords);
+// writes the next token into token and returns 1 or returns 0 at the end of the input
+// while more is set a token or comment that touches the end of the input might still go on so it returns -1 instead, only
+// moving past the whitespace and comments in front of it, the caller appends the next piece of input (moving input and
+// current along if the buffer moved) and calls it again
+int lexer_next(Lexer *lexer, Token *token);
+// takes comments out of the token stream from now on, when trivia is not NULL they and the whitespace get recorded there
+void lexer_strip(Lexer *lexer, TriviaTable *trivia);
+// same as lexer_run but the tokens have no comments, the compiler uses this so it never copies comment text around
+Token *lexer_run_stripped(char *input, size_t *count, TrieNode *keywords, TriviaTable *trivia);
+// length of the // or /* comment that starts at current, closed is 0 when a block comment runs into the end of the input
+size_t comment_length(const char *current, int *closed);
+void trivia_init(TriviaTable *table);
+void trivia_free(TriviaTable *table);
+// writes the source back out from the tokens and the trivia they were lexed with, the text of each token is the length
+// bytes of source at its offset so nothing gets cut and anything the tokens and trivia miss or cover twice shows up
+void lexer_rebuild(FILE *out, const char *source, const Token *tokens, size_t count, const TriviaTable *trivia);
+// reads a whole source file into a null terminated buffer the caller frees it, length can be NULL
+char *read_source(const char *path, size_t *length);
+// the lexer parser and compiler print their errors to error_stream(), that is stderr unless this thread set errorStream
+// (the build points it at a buffer per module so modules compiling at the same time never mix their errors)
+extern _Thread_local FILE *errorStream;
+FILE *error_stream(void);
 
 #endif
\ No newline at end of file
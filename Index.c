@@ -0,0 +1,550 @@
+// here is the identifier index (see Index.h) changed files are lexed on several threads, everything else comes out of the
+// old index, then all the postings get sorted and written out as one file that queries mmap
+
+#include <sys/mman.h> // mapping the index for queries
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h> // lexing threads
+#include <limits.h> // PATH_MAX
+#include "Build.h" // BUILD_DIR
+#include "Index.h"
+
+// one .unn file found under the directory
+typedef struct {
+        char *path;
+        int64_t mtime;
+        int64_t size;
+        int64_t oldId; // id in the old index or -1 when it has to be lexed
+        // filled in by the lexing threads
+        char *names; // identifiers one after another each '\0' terminated
+        uint32_t *offsets; // byte offset of each of them
+        size_t count;
+} SourceFile;
+
+typedef struct {
+        uint64_t *items; // file id << 32 | byte offset so sorting the numbers sorts by file and then offset
+        size_t count;
+        size_t cap;
+} Postings;
+
+typedef struct {
+        SourceFile *files;
+        size_t fileCount;
+        size_t fileCap;
+        SymbolTable names; // identifier -> id into postings
+        Postings *postings;
+        size_t postingCap;
+        TrieNode *keywords;
+        size_t nextFile; // next file a lexing thread has not taken
+        pthread_mutex_t lock;
+} Indexer;
+
+// the old index mapped into memory and checked so nothing in it can point outside the file
+typedef struct {
+        unsigned char *data;
+        size_t size;
+        const IndexHeader *header;
+        const IndexFile *files;
+        const IndexIdent *idents;
+        const char *strings;
+        size_t stringsLen;
+        const unsigned char *postings;
+        size_t postingsLen;
+} IndexMap;
+
+typedef struct {
+        unsigned char *data;
+        size_t len;
+        size_t cap;
+} Bytes;
+
+static void put_bytes(Bytes *bytes, const void *data, size_t length) {
+        if (bytes->len + length > bytes->cap) {
+                size_t newCap = bytes->cap ? bytes->cap : 4096;
+                while (newCap < bytes->len + length) newCap *= 2;
+                unsigned char *newData = realloc(bytes->data, newCap);
+                if (!newData) {
+                        fprintf(stderr, "INDEX ERROR: Out of memory\n");
+                        exit(1);
+                }
+                bytes->data = newData;
+                bytes->cap = newCap;
+        }
+        memcpy(bytes->data + bytes->len, data, length);
+        bytes->len += length;
+}
+
+// LEB128, 7 bits at a time with the top bit set on every byte but the last
+static void put_varint(Bytes *bytes, uint64_t value) {
+        unsigned char buffer[10];
+        size_t len = 0;
+        while (value >= 0x80) {
+                buffer[len++] = (unsigned char)(value | 0x80);
+                value >>= 7;
+        }
+        buffer[len++] = (unsigned char)value;
+        put_bytes(bytes, buffer, len);
+}
+
+static uint64_t get_varint(const unsigned char **at, const unsigned char *end, int *ok) {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+                if (*at >= end) break;
+                unsigned char byte = *(*at)++;
+                value |= (uint64_t)(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) return value;
+        }
+        *ok = 0;
+        return 0;
+}
+
+static void add_posting(Indexer *indexer, const char *name, uint64_t item) {
+        size_t id = (size_t)symbol_intern(&indexer->names, name);
+        if (id >= indexer->postingCap) {
+                size_t newCap = indexer->postingCap ? indexer->postingCap * 2 : 1024;
+                while (newCap <= id) newCap *= 2;
+                Postings *newPostings = realloc(indexer->postings, sizeof(Postings) * newCap);
+                if (!newPostings) {
+                        fprintf(stderr, "INDEX ERROR: Out of memory\n");
+                        exit(1);
+                }
+                memset(newPostings + indexer->postingCap, 0, sizeof(Postings) * (newCap - indexer->postingCap));
+                indexer->postings = newPostings;
+                indexer->postingCap = newCap;
+        }
+        Postings *postings = &indexer->postings[id];
+        if (postings->count >= postings->cap) {
+                postings->cap = postings->cap ? postings->cap * 2 : 4;
+                postings->items = realloc(postings->items, sizeof(uint64_t) * postings->cap);
+                if (!postings->items) {
+                        fprintf(stderr, "INDEX ERROR: Out of memory\n");
+                        exit(1);
+                }
+        }
+        postings->items[postings->count++] = item;
+}
+
+static void collect(Indexer *indexer, const char *dir) {
+        DIR *handle = opendir(dir);
+        if (!handle) return;
+        struct dirent *entry;
+        while ((entry = readdir(handle))) {
+                // hidden entries are skipped which also keeps the build directory out
+                if (entry->d_name[0] == '.') continue;
+                char path[PATH_MAX];
+                if (snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name) >= (int)sizeof(path)) continue;
+                struct stat info;
+                if (stat(path, &info) != 0) continue;
+                size_t len = strlen(entry->d_name);
+                if (S_ISDIR(info.st_mode)) collect(indexer, path);
+                else if (len > 4 && strcmp(entry->d_name + len - 4, ".unn") == 0) {
+                        if (indexer->fileCount >= indexer->fileCap) {
+                                indexer->fileCap = indexer->fileCap ? indexer->fileCap * 2 : 64;
+                                indexer->files = realloc(indexer->files, sizeof(SourceFile) * indexer->fileCap);
+                                if (!indexer->files) {
+                                        fprintf(stderr, "INDEX ERROR: Out of memory\n");
+                                        exit(1);
+                                }
+                        }
+                        SourceFile *file = &indexer->files[indexer->fileCount++];
+                        memset(file, 0, sizeof(SourceFile));
+                        file->path = strdup(path);
+                        file->mtime = (int64_t)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec;
+                        file->size = (int64_t)info.st_size;
+                        file->oldId = -1;
+                }
+        }
+        closedir(handle);
+}
+
+static int compare_files(const void *a, const void *b) {
+        return strcmp(((const SourceFile *)a)->path, ((const SourceFile *)b)->path);
+}
+
+// tokens are taken one at a time so a big file never needs its whole token array in memory
+static void lex_file(Indexer *indexer, SourceFile *file) {
+        char *input = read_source(file->path, NULL);
+        if (!input) return;
+        Lexer lexer;
+        Token token;
+        Bytes names = {0}, offsets = {0};
+        lexer_init(&lexer, input, indexer->keywords);
+        lexer_strip(&lexer, NULL);
+        while (lexer_next(&lexer, &token)) {
+                if (token.type != IDENTIFIER || token.offset > UINT32_MAX) continue;
+                uint32_t offset = (uint32_t)token.offset;
+                put_bytes(&names, token.lexeme, strlen(token.lexeme) + 1);
+                put_bytes(&offsets, &offset, sizeof(offset));
+                file->count++;
+        }
+        free(input);
+        file->names = (char *)names.data;
+        file->offsets = (uint32_t *)offsets.data;
+}
+
+static void *lex_worker(void *arg) {
+        Indexer *indexer = arg;
+        while (1) {
+                pthread_mutex_lock(&indexer->lock);
+                size_t index = indexer->nextFile;
+                while (index < indexer->fileCount && indexer->files[index].oldId >= 0) index++;
+                indexer->nextFile = index + 1;
+                pthread_mutex_unlock(&indexer->lock);
+                if (index >= indexer->fileCount) return NULL;
+                lex_file(indexer, &indexer->files[index]);
+        }
+}
+
+static int index_map(const char *path, IndexMap *map) {
+        memset(map, 0, sizeof(IndexMap));
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return 0;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(IndexHeader)) {
+                close(fd);
+                return 0;
+        }
+        void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) return 0;
+        map->data = data;
+        map->size = (size_t)info.st_size;
+
+        const IndexHeader *header = data;
+        int ok = header->magic == INDEX_MAGIC && header->version == INDEX_VERSION && header->size == map->size;
+        ok = ok && header->files == sizeof(IndexHeader) && header->files + (uint64_t)header->fileCount * sizeof(IndexFile) == header->idents;
+        ok = ok && header->idents + (uint64_t)header->identCount * sizeof(IndexIdent) == header->strings;
+        ok = ok && header->strings < header->postings && header->postings <= header->size;
+        if (ok) {
+                map->header = header;
+                map->files = (const IndexFile *)(map->data + header->files);
+                map->idents = (const IndexIdent *)(map->data + header->idents);
+                map->strings = (const char *)map->data + header->strings;
+                map->stringsLen = header->postings - header->strings;
+                map->postings = map->data + header->postings;
+                map->postingsLen = header->size - header->postings;
+                // the string section always ends in '\0' so any offset inside it is a terminated string
+                ok = map->strings[map->stringsLen - 1] == '\0';
+        }
+        for (uint32_t i = 0; ok && i < header->fileCount; i++) ok = map->files[i].path < map->stringsLen;
+        for (uint32_t i = 0; ok && i < header->identCount; i++) {
+                const IndexIdent *ident = &map->idents[i];
+                ok = ident->name < map->stringsLen && ident->postings <= map->postingsLen && ident->length <= map->postingsLen - ident->postings;
+        }
+        if (!ok) {
+                munmap(map->data, map->size);
+                memset(map, 0, sizeof(IndexMap));
+        }
+        return ok;
+}
+
+static void index_unmap(IndexMap *map) {
+        if (map->data) munmap(map->data, map->size);
+        memset(map, 0, sizeof(IndexMap));
+}
+
+// calls back for every (file id, offset) of one identifier in order, returns 0 if the postings are damaged
+typedef void (*PostingFn)(void *arg, uint64_t file, uint64_t offset);
+
+static int decode_postings(const IndexMap *map, const IndexIdent *ident, PostingFn fn, void *arg) {
+        const unsigned char *at = map->postings + ident->postings, *end = at + ident->length;
+        uint64_t file = 0;
+        int ok = 1;
+        while (ok && at < end) {
+                file += get_varint(&at, end, &ok);
+                uint64_t count = get_varint(&at, end, &ok), offset = 0;
+                if (file >= map->header->fileCount) ok = 0;
+                for (uint64_t i = 0; ok && i < count; i++) {
+                        offset += get_varint(&at, end, &ok);
+                        if (ok) fn(arg, file, offset);
+                }
+        }
+        return ok;
+}
+
+typedef struct {
+        Indexer *indexer;
+        const char *name;
+        const int64_t *remap; // old file id -> new file id or -1 for files that changed or are gone
+} CarryOver;
+
+static void carry_posting(void *arg, uint64_t file, uint64_t offset) {
+        CarryOver *carry = arg;
+        if (carry->remap[file] >= 0) add_posting(carry->indexer, carry->name, (uint64_t)carry->remap[file] << 32 | offset);
+}
+
+static int compare_items(const void *a, const void *b) {
+        uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+        return (x > y) - (x < y);
+}
+
+static const SymbolTable *sortNames; // qsort has no argument for the table
+
+static int compare_names(const void *a, const void *b) {
+        return strcmp(symbol_name(sortNames, *(const int *)a), symbol_name(sortNames, *(const int *)b));
+}
+
+static int write_index(Indexer *indexer, const char *path, IndexStats *stats) {
+        size_t identCount = indexer->names.count;
+        int *order = malloc(sizeof(int) * (identCount + 1));
+        IndexFile *files = calloc(indexer->fileCount + 1, sizeof(IndexFile));
+        IndexIdent *idents = calloc(identCount + 1, sizeof(IndexIdent));
+        Bytes strings = {0}, postings = {0};
+        if (!order || !files || !idents) {
+                fprintf(stderr, "INDEX ERROR: Out of memory\n");
+                exit(1);
+        }
+        for (size_t i = 0; i < indexer->fileCount; i++) {
+                files[i].path = (uint32_t)strings.len;
+                files[i].mtime = indexer->files[i].mtime;
+                files[i].size = indexer->files[i].size;
+                put_bytes(&strings, indexer->files[i].path, strlen(indexer->files[i].path) + 1);
+        }
+        for (size_t i = 0; i < identCount; i++) order[i] = (int)i;
+        sortNames = &indexer->names;
+        qsort(order, identCount, sizeof(int), compare_names);
+
+        stats->occurrences = 0;
+        for (size_t i = 0; i < identCount; i++) {
+                const char *name = symbol_name(&indexer->names, order[i]);
+                Postings *list = &indexer->postings[order[i]];
+                qsort(list->items, list->count, sizeof(uint64_t), compare_items);
+                idents[i].name = (uint32_t)strings.len;
+                idents[i].count = (uint32_t)list->count;
+                idents[i].postings = postings.len;
+                put_bytes(&strings, name, strlen(name) + 1);
+                // (file delta, count, offset deltas...) for every file the name shows up in
+                uint64_t lastFile = 0;
+                for (size_t j = 0; j < list->count;) {
+                        uint64_t file = list->items[j] >> 32, lastOffset = 0;
+                        size_t end = j;
+                        while (end < list->count && list->items[end] >> 32 == file) end++;
+                        put_varint(&postings, file - lastFile);
+                        put_varint(&postings, end - j);
+                        for (; j < end; j++) {
+                                uint64_t offset = list->items[j] & 0xFFFFFFFFu;
+                                put_varint(&postings, offset - lastOffset);
+                                lastOffset = offset;
+                        }
+                        lastFile = file;
+                }
+                idents[i].length = postings.len - idents[i].postings;
+                stats->occurrences += list->count;
+        }
+        put_bytes(&strings, "", 1); // makes sure the section ends in '\0' even when it is empty
+        while (strings.len % 8) put_bytes(&strings, "", 1);
+
+        IndexHeader header;
+        memset(&header, 0, sizeof(header));
+        header.magic = INDEX_MAGIC;
+        header.version = INDEX_VERSION;
+        header.fileCount = (uint32_t)indexer->fileCount;
+        header.identCount = (uint32_t)identCount;
+        header.files = sizeof(IndexHeader);
+        header.idents = header.files + sizeof(IndexFile) * indexer->fileCount;
+        header.strings = header.idents + sizeof(IndexIdent) * identCount;
+        header.postings = header.strings + strings.len;
+        header.size = header.postings + postings.len;
+
+        // written next to the old one and renamed over it so a query never sees half an index
+        char temp[PATH_MAX + 8];
+        snprintf(temp, sizeof(temp), "%s.tmp", path);
+        FILE *file = fopen(temp, "wb");
+        int ok = file != NULL;
+        if (ok) {
+                ok = fwrite(&header, sizeof(header), 1, file) == 1;
+                ok = ok && fwrite(files, sizeof(IndexFile), indexer->fileCount, file) == indexer->fileCount;
+                ok = ok && fwrite(idents, sizeof(IndexIdent), identCount, file) == identCount;
+                ok = ok && fwrite(strings.data, 1, strings.len, file) == strings.len;
+                ok = ok && fwrite(postings.data, 1, postings.len, file) == postings.len;
+                ok = fclose(file) == 0 && ok;
+                if (ok) ok = rename(temp, path) == 0;
+                if (!ok) remove(temp);
+        }
+        if (!ok) fprintf(stderr, "INDEX ERROR: Could not write '%s'\n", path);
+        stats->idents = identCount;
+        free(order);
+        free(files);
+        free(idents);
+        free(strings.data);
+        free(postings.data);
+        return ok;
+}
+
+static int index_path(const char *dir, char *resolved, char *out) {
+        struct stat info;
+        if (!realpath(dir, resolved) || stat(resolved, &info) != 0 || !S_ISDIR(info.st_mode)) {
+                fprintf(stderr, "INDEX ERROR: '%s' is not a directory\n", dir);
+                return 0;
+        }
+        snprintf(out, PATH_MAX, "%s/%s/%s", resolved, BUILD_DIR, INDEX_FILE);
+        return 1;
+}
+
+int index_update(const char *dir, int jobs, IndexStats *stats) {
+        char resolved[PATH_MAX], path[PATH_MAX];
+        memset(stats, 0, sizeof(IndexStats));
+        if (!index_path(dir, resolved, path)) return 1;
+
+        Indexer indexer;
+        memset(&indexer, 0, sizeof(indexer));
+        symbol_table_init(&indexer.names);
+        pthread_mutex_init(&indexer.lock, NULL);
+        collect(&indexer, resolved);
+        qsort(indexer.files, indexer.fileCount, sizeof(SourceFile), compare_files);
+
+        // files that did not change keep their postings from the old index
+        IndexMap old;
+        int64_t *remap = NULL;
+        if (index_map(path, &old)) {
+                SymbolTable paths;
+                symbol_table_init(&paths);
+                for (size_t i = 0; i < indexer.fileCount; i++) symbol_intern(&paths, indexer.files[i].path);
+                remap = malloc(sizeof(int64_t) * (old.header->fileCount + 1));
+                for (uint32_t i = 0; i < old.header->fileCount; i++) {
+                        int id = symbol_find(&paths, old.strings + old.files[i].path);
+                        SourceFile *file = id >= 0 ? &indexer.files[id] : NULL;
+                        remap[i] = -1;
+                        if (file && file->mtime == old.files[i].mtime && file->size == old.files[i].size) {
+                                file->oldId = i;
+                                remap[i] = id;
+                        }
+                }
+                symbol_table_free(&paths);
+        }
+
+        if (remap) {
+                int ok = 1;
+                for (uint32_t i = 0; ok && i < old.header->identCount; i++) {
+                        CarryOver carry = {&indexer, old.strings + old.idents[i].name, remap};
+                        ok = decode_postings(&old, &old.idents[i], carry_posting, &carry);
+                }
+                if (!ok) {
+                        // throw away whatever came out of it and lex everything
+                        fprintf(stderr, "INDEX WARNING: '%s' is damaged every file gets lexed again\n", path);
+                        for (size_t i = 0; i < indexer.names.count; i++) free(indexer.postings[i].items);
+                        memset(indexer.postings, 0, sizeof(Postings) * indexer.postingCap);
+                        symbol_table_free(&indexer.names);
+                        symbol_table_init(&indexer.names);
+                        for (size_t i = 0; i < indexer.fileCount; i++) indexer.files[i].oldId = -1;
+                }
+                free(remap);
+                index_unmap(&old);
+        }
+
+        indexer.keywords = lexer_keywords();
+        if (jobs < 1) jobs = 1;
+        pthread_t *threads = malloc(sizeof(pthread_t) * jobs);
+        int started = 0;
+        while (threads && started < jobs - 1 && pthread_create(&threads[started], NULL, lex_worker, &indexer) == 0) started++;
+        lex_worker(&indexer);
+        for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+        free(threads);
+        freeTrie(indexer.keywords);
+
+        int ok = 1;
+        for (size_t i = 0; i < indexer.fileCount; i++) {
+                SourceFile *file = &indexer.files[i];
+                stats->lexed += file->oldId < 0;
+                const char *name = file->names;
+                for (size_t j = 0; j < file->count; j++) {
+                        add_posting(&indexer, name, (uint64_t)i << 32 | file->offsets[j]);
+                        name += strlen(name) + 1;
+                }
+        }
+        stats->files = indexer.fileCount;
+
+        char buildDir[PATH_MAX + 16];
+        snprintf(buildDir, sizeof(buildDir), "%s/%s", resolved, BUILD_DIR);
+        if (ok && mkdir(buildDir, 0777) != 0 && access(buildDir, W_OK) != 0) {
+                fprintf(stderr, "INDEX ERROR: Cannot create '%s'\n", buildDir);
+                ok = 0;
+        }
+        if (ok) ok = write_index(&indexer, path, stats);
+
+        for (size_t i = 0; i < indexer.fileCount; i++) {
+                free(indexer.files[i].path);
+                free(indexer.files[i].names);
+                free(indexer.files[i].offsets);
+        }
+        free(indexer.files);
+        for (size_t i = 0; i < indexer.names.count; i++) free(indexer.postings[i].items);
+        free(indexer.postings);
+        symbol_table_free(&indexer.names);
+        pthread_mutex_destroy(&indexer.lock);
+        return ok ? 0 : 1;
+}
+
+typedef struct {
+        const IndexMap *map;
+        FILE *out;
+        long found;
+        uint64_t file; // file whose contents are loaded
+        char *source;
+        size_t length;
+        size_t line; // line and column at position
+        size_t col;
+        size_t position;
+} Printer;
+
+// offsets come in increasing order within a file so the line and column are worked out in one pass over it
+static void print_posting(void *arg, uint64_t file, uint64_t offset) {
+        Printer *printer = arg;
+        const char *path = printer->map->strings + printer->map->files[file].path;
+        if (!printer->source || printer->file != file) {
+                free(printer->source);
+                printer->source = read_source(path, &printer->length);
+                printer->file = file;
+                printer->line = printer->col = 1;
+                printer->position = 0;
+                if (printer->source && (int64_t)printer->length != printer->map->files[file].size) {
+                        fprintf(stderr, "INDEX WARNING: '%s' changed since it was indexed\n", path);
+                }
+        }
+        while (printer->source && printer->position < offset && printer->position < printer->length) {
+                if (printer->source[printer->position++] == '\n') {
+                        printer->line++;
+                        printer->col = 1;
+                } else printer->col++;
+        }
+        if (printer->source) fprintf(printer->out, "%s:%lu:%lu\n", path, printer->line, printer->col);
+        else fprintf(printer->out, "%s:+%llu\n", path, (unsigned long long)offset);
+        printer->found++;
+}
+
+long index_query(const char *dir, const char *name, FILE *out) {
+        char resolved[PATH_MAX], path[PATH_MAX];
+        if (!index_path(dir, resolved, path)) return -1;
+        IndexMap map;
+        if (!index_map(path, &map)) {
+                fprintf(stderr, "INDEX ERROR: No usable index in '%s' make one with ./unn --index %s\n", resolved, dir);
+                return -1;
+        }
+        // binary search over the sorted identifiers
+        size_t low = 0, high = map.header->identCount;
+        while (low < high) {
+                size_t mid = low + (high - low) / 2;
+                int cmp = strcmp(map.strings + map.idents[mid].name, name);
+                if (cmp == 0) {
+                        low = mid;
+                        break;
+                }
+                if (cmp < 0) low = mid + 1;
+                else high = mid;
+        }
+        Printer printer;
+        memset(&printer, 0, sizeof(printer));
+        printer.map = &map;
+        printer.out = out;
+        if (low < map.header->identCount && strcmp(map.strings + map.idents[low].name, name) == 0) {
+                if (!decode_postings(&map, &map.idents[low], print_posting, &printer)) {
+                        fprintf(stderr, "INDEX ERROR: '%s' is damaged remove it and index again\n", path);
+                        printer.found = -1;
+                }
+        }
+        free(printer.source);
+        index_unmap(&map);
+        return printer.found;
+}
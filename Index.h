@@ -0,0 +1,62 @@
+// this is the header for the identifier index, it answers "where is this name used" for a whole tree of .unn files without
+// lexing anything at query time
+//
+// the index is one file (.unnbuild/index inside the indexed directory) laid out so it can be mmapped and searched in place
+//   header
+//   files        path mtime and size of every indexed file, a file id is the position in this table
+//   identifiers  sorted by name so a lookup is a binary search, each one points at its postings
+//   strings      every path and name '\0' terminated
+//   postings     per identifier the (file id, byte offset) of every occurrence grouped by file, the file ids and the offsets
+//                inside a file are both stored as the difference from the previous one in LEB128 varints
+// updating only lexes the files whose mtime or size changed, the postings of the other files are copied over from the old
+// index (the file itself is always written out again in one go since every posting list can change)
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define INDEX_MAGIC 0x584E4E55u // "UNNX"
+#define INDEX_VERSION 1
+#define INDEX_FILE "index" // inside BUILD_DIR
+
+typedef struct {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t fileCount;
+        uint32_t identCount;
+        uint64_t files; // byte offsets of the sections from the start of the file
+        uint64_t idents;
+        uint64_t strings;
+        uint64_t postings;
+        uint64_t size; // of the whole file so a cut off index is caught
+} IndexHeader;
+
+typedef struct {
+        uint32_t path; // offset into strings
+        uint32_t unused;
+        int64_t mtime; // nanoseconds
+        int64_t size;
+} IndexFile;
+
+typedef struct {
+        uint32_t name; // offset into strings
+        uint32_t count; // occurrences
+        uint64_t postings; // offset into postings
+        uint64_t length; // bytes of postings
+} IndexIdent;
+
+typedef struct {
+        size_t files; // files in the index
+        size_t lexed; // files that had to be lexed this time
+        size_t idents;
+        size_t occurrences;
+} IndexStats;
+
+// brings the index of every .unn file under dir up to date using jobs threads to lex, returns 0 when it worked
+int index_update(const char *dir, int jobs, IndexStats *stats);
+// prints path:line:col for every use of name in the index of dir, returns the number found or -1 if there is no usable index
+long index_query(const char *dir, const char *name, FILE *out);
+
+#endif
@@ -0,0 +1,647 @@
+// here is the baseline JIT it translates the bytecode of a function one instruction at a time into x86-64 machine code
+//
+// every VM register gets a live interval (first to last instruction that touches it, stretched over any loop it is used in)
+// and linear scan register allocation hands out machine registers in order of interval start, when there are more live
+// intervals than machine registers the one that lives the longest gets spilled and lives in its Value slot of the frame instead
+// the machine code goes into memory from mmap that is made executable (and read only) with mprotect once it has been written
+
+#include "Bytecode.h"
+#include "JIT.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h> // mmap mprotect munmap
+#include <unistd.h> // sysconf for the page size
+#include <stddef.h> // offsetof
+
+// x86-64 register numbers as they go into the instruction encoding
+enum { RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI, R8, R9, R10, R11, R12, R13, R14, R15 };
+
+// rax rcx and rdx are scratch registers (idiv and shifts need them) rdi holds the frame base and rsi the result pointer
+static const int pool[] = { RBX, R12, R13, R14, R15, R8, R9, R10, R11 };
+#define POOL_LEN ((int)(sizeof(pool) / sizeof(pool[0])))
+#define SAVED_LEN 5 // the first five registers of the pool are callee saved and get pushed in the prologue
+
+// condition codes for jcc and setcc
+enum { CC_E = 0x4, CC_NE = 0x5, CC_L = 0xC, CC_GE = 0xD, CC_LE = 0xE, CC_G = 0xF };
+
+// return codes of the generated function
+enum { JIT_BAIL = 0, JIT_INT = 1, JIT_NIL = 2 };
+
+typedef int (*JitFn)(Value *base, long long *result);
+
+// machine code buffer plus the jumps that need their targets filled in once every instruction has been placed
+typedef struct {
+        uint8_t *code;
+        size_t len;
+        size_t cap;
+        size_t *labels; // machine code offset of every bytecode word
+        size_t *fixups; // offsets of rel32 fields to patch
+        size_t *targets; // bytecode pc each fixup jumps to
+        size_t fixupCount;
+        size_t fixupCap;
+        size_t *bails; // rel32 fields of jumps to the bail out stub
+        size_t bailCount;
+        size_t bailCap;
+        int *location; // machine register of every VM register or -1 when it is spilled
+        int ok;
+} Assembler;
+
+static void byte(Assembler *as, uint8_t value) {
+        if (as->len >= as->cap) {
+                size_t newCap = as->cap ? as->cap * 2 : 1024;
+                uint8_t *newCode = realloc(as->code, newCap);
+                if (!newCode) {
+                        as->ok = 0;
+                        return;
+                }
+                as->code = newCode;
+                as->cap = newCap;
+        }
+        as->code[as->len++] = value;
+}
+
+static void int32(Assembler *as, int32_t value) {
+        for (int i = 0; i < 4; i++) byte(as, (uint8_t)((uint32_t)value >> (8 * i)));
+}
+
+static void patch32(Assembler *as, size_t at, int32_t value) {
+        for (int i = 0; i < 4; i++) as->code[at + i] = (uint8_t)((uint32_t)value >> (8 * i));
+}
+
+// REX.W prefix with the extension bits for reg (modrm.reg) and rm (modrm.rm)
+static void rex(Assembler *as, int reg, int rm) {
+        byte(as, (uint8_t)(0x48 | ((reg >> 3) << 2) | (rm >> 3)));
+}
+
+// register to register modrm
+static void modrm_rr(Assembler *as, int reg, int rm) {
+        byte(as, (uint8_t)(0xC0 | ((reg & 7) << 3) | (rm & 7)));
+}
+
+// [base + disp32] modrm
+static void modrm_mem(Assembler *as, int reg, int base, int32_t disp) {
+        byte(as, (uint8_t)(0x80 | ((reg & 7) << 3) | (base & 7)));
+        if ((base & 7) == RSP) byte(as, 0x24); // rsp and r12 as a base need a SIB byte
+        int32(as, disp);
+}
+
+// op r/m64, r64 for the two operand instructions (add sub and or xor cmp mov test)
+static void op_rr(Assembler *as, uint8_t opcode, int dst, int src) {
+        rex(as, src, dst);
+        byte(as, opcode);
+        modrm_rr(as, src, dst);
+}
+
+static void mov_rr(Assembler *as, int dst, int src) {
+        if (dst != src) op_rr(as, 0x89, dst, src);
+}
+
+static void mov_load(Assembler *as, int dst, int base, int32_t disp) {
+        rex(as, dst, base);
+        byte(as, 0x8B);
+        modrm_mem(as, dst, base, disp);
+}
+
+static void mov_store(Assembler *as, int base, int32_t disp, int src) {
+        rex(as, src, base);
+        byte(as, 0x89);
+        modrm_mem(as, src, base, disp);
+}
+
+static void mov_imm(Assembler *as, int dst, long long value) {
+        if (value >= INT32_MIN && value <= INT32_MAX) {
+                rex(as, 0, dst);
+                byte(as, 0xC7);
+                modrm_rr(as, 0, dst);
+                int32(as, (int32_t)value);
+        } else {
+                rex(as, 0, dst);
+                byte(as, (uint8_t)(0xB8 + (dst & 7)));
+                for (int i = 0; i < 8; i++) byte(as, (uint8_t)((unsigned long long)value >> (8 * i)));
+        }
+}
+
+// 81 /digit id for add (0) and cmp (7) with an immediate
+static void op_imm(Assembler *as, int digit, int dst, int32_t value) {
+        rex(as, 0, dst);
+        byte(as, 0x81);
+        modrm_rr(as, digit, dst);
+        int32(as, value);
+}
+
+static void imul_rr(Assembler *as, int dst, int src) {
+        rex(as, dst, src);
+        byte(as, 0x0F);
+        byte(as, 0xAF);
+        modrm_rr(as, dst, src);
+}
+
+// F7 /digit for not (2) neg (3) and idiv (7) D3 /digit for shl (4) and sar (7) by cl
+static void unary(Assembler *as, uint8_t opcode, int digit, int dst) {
+        rex(as, 0, dst);
+        byte(as, opcode);
+        modrm_rr(as, digit, dst);
+}
+
+// setcc al then movzx eax al so rax holds 0 or 1
+static void setcc(Assembler *as, int cc) {
+        byte(as, 0x0F);
+        byte(as, (uint8_t)(0x90 | cc));
+        byte(as, 0xC0);
+        byte(as, 0x0F);
+        byte(as, 0xB6);
+        byte(as, 0xC0);
+}
+
+static void push(Assembler *as, int reg) {
+        if (reg >= R8) byte(as, 0x41);
+        byte(as, (uint8_t)(0x50 + (reg & 7)));
+}
+
+static void pop(Assembler *as, int reg) {
+        if (reg >= R8) byte(as, 0x41);
+        byte(as, (uint8_t)(0x58 + (reg & 7)));
+}
+
+static void add_fixup(Assembler *as, size_t at, size_t target) {
+        if (as->fixupCount >= as->fixupCap) {
+                size_t newCap = as->fixupCap ? as->fixupCap * 2 : 32;
+                size_t *newFixups = realloc(as->fixups, sizeof(size_t) * newCap);
+                size_t *newTargets = newFixups ? realloc(as->targets, sizeof(size_t) * newCap) : NULL;
+                if (newFixups) as->fixups = newFixups;
+                if (!newFixups || !newTargets) {
+                        as->ok = 0;
+                        return;
+                }
+                as->targets = newTargets;
+                as->fixupCap = newCap;
+        }
+        as->fixups[as->fixupCount] = at;
+        as->targets[as->fixupCount++] = target;
+}
+
+// jcc (or jmp when cc is -1) to the machine code for bytecode word target
+static void jump_to(Assembler *as, int cc, size_t target) {
+        if (cc < 0) byte(as, 0xE9);
+        else {
+                byte(as, 0x0F);
+                byte(as, (uint8_t)(0x80 | cc));
+        }
+        add_fixup(as, as->len, target);
+        int32(as, 0);
+}
+
+// jcc to the shared bail out stub at the end of the function
+static void jump_bail(Assembler *as, int cc) {
+        byte(as, 0x0F);
+        byte(as, (uint8_t)(0x80 | cc));
+        if (as->bailCount >= as->bailCap) {
+                size_t newCap = as->bailCap ? as->bailCap * 2 : 8;
+                size_t *newBails = realloc(as->bails, sizeof(size_t) * newCap);
+                if (!newBails) {
+                        as->ok = 0;
+                        return;
+                }
+                as->bails = newBails;
+                as->bailCap = newCap;
+        }
+        as->bails[as->bailCount++] = as->len;
+        int32(as, 0);
+}
+
+// payload of VM register reg in the frame
+static int32_t slot(int reg) {
+        return (int32_t)(reg * sizeof(Value) + offsetof(Value, as));
+}
+
+// loads VM register reg into scratch register dst
+static void load(Assembler *as, int dst, int reg) {
+        if (as->location[reg] >= 0) mov_rr(as, dst, as->location[reg]);
+        else mov_load(as, dst, RDI, slot(reg));
+}
+
+// stores scratch register src into VM register reg
+static void store(Assembler *as, int reg, int src) {
+        if (as->location[reg] >= 0) mov_rr(as, as->location[reg], src);
+        else mov_store(as, RDI, slot(reg), src);
+}
+
+// an int constant from the constant table or 0 if it isnt one
+static int int_constant(const Function *function, int index, long long *value) {
+        if ((size_t)index >= function->constCount || function->constants[index].type != VAL_INT) return 0;
+        *value = function->constants[index].as.i;
+        return 1;
+}
+
+// checks that every instruction is one we can translate
+static int supported(const Function *function) {
+        if (function->isMethod || function->isConstructor) return 0; // this is an object not an int
+        long long value;
+        for (size_t pc = 0; pc < function->codeLen; pc += op_width(OP(function->code[pc]))) {
+                uint32_t ins = function->code[pc];
+                switch (OP(ins)) {
+                        case OP_MOVE: case OP_LOADI: case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+                        case OP_ADDI: case OP_BAND: case OP_BOR: case OP_BXOR: case OP_SHL: case OP_SHR:
+                        case OP_EQ: case OP_NE: case OP_LT: case OP_LE: case OP_NEG: case OP_NOT:
+                        case OP_JMP: case OP_JMPF: case OP_JMPT: case OP_IFLT: case OP_IFLE: case OP_IFEQ: case OP_IFNE:
+                        case OP_RETURN:
+                                break;
+                        case OP_LOADK:
+                                if (!int_constant(function, ARG_Bx(ins), &value)) return 0;
+                                break;
+                        case OP_ADDK: case OP_SUBK: case OP_MULK: case OP_DIVK: case OP_MODK:
+                                if (!int_constant(function, ARG_C(ins), &value)) return 0;
+                                break;
+                        case OP_IFLTK: case OP_IFLEK: case OP_IFGTK: case OP_IFGEK: case OP_IFEQK: case OP_IFNEK:
+                                if (!int_constant(function, ARG_B(ins), &value)) return 0;
+                                break;
+                        default:
+                                return 0;
+                }
+        }
+        return 1;
+}
+
+// bytecode word a jump or wide branch at pc goes to
+static size_t branch_target(const Function *function, size_t pc) {
+        uint32_t ins = function->code[pc];
+        if (OP(ins) == OP_JMP) return (size_t)((long)pc + 1 + ARG_sAx(ins));
+        return (size_t)((long)pc + 2 + (int32_t)function->code[pc + 1]);
+}
+
+static int is_branch(OpCode op) {
+        return op == OP_JMP || op == OP_JMPF || op == OP_JMPT || (op >= OP_IFLT && op <= OP_IFNEK);
+}
+
+// registers an instruction reads or writes at most three
+static int touched(uint32_t ins, int *regs) {
+        switch (OP(ins)) {
+                case OP_LOADI: case OP_LOADK: case OP_JMPF: case OP_JMPT:
+                case OP_IFLTK: case OP_IFLEK: case OP_IFGTK: case OP_IFGEK: case OP_IFEQK: case OP_IFNEK:
+                        regs[0] = ARG_A(ins);
+                        return 1;
+                case OP_RETURN:
+                        regs[0] = ARG_A(ins);
+                        return ARG_B(ins) ? 1 : 0;
+                case OP_MOVE: case OP_ADDI: case OP_NEG: case OP_NOT: case OP_IFLT: case OP_IFLE: case OP_IFEQ: case OP_IFNE:
+                case OP_ADDK: case OP_SUBK: case OP_MULK: case OP_DIVK: case OP_MODK:
+                        regs[0] = ARG_A(ins);
+                        regs[1] = ARG_B(ins);
+                        return 2;
+                case OP_JMP:
+                        return 0;
+                default:
+                        regs[0] = ARG_A(ins);
+                        regs[1] = ARG_B(ins);
+                        regs[2] = ARG_C(ins);
+                        return 3;
+        }
+}
+
+// builds the live intervals and runs linear scan over them filling location
+static void allocate_registers(const Function *function, int *location) {
+        int count = function->registers;
+        long start[MAX_REGISTERS + 1], end[MAX_REGISTERS + 1];
+        for (int r = 0; r < count; r++) {
+                start[r] = r < function->arity ? 0 : -1; // parameters are live from the first instruction
+                end[r] = r < function->arity ? 0 : -1;
+                location[r] = -1;
+        }
+        for (size_t pc = 0; pc < function->codeLen; pc += op_width(OP(function->code[pc]))) {
+                int regs[3];
+                int n = touched(function->code[pc], regs);
+                for (int i = 0; i < n; i++) {
+                        if (start[regs[i]] < 0) start[regs[i]] = (long)pc;
+                        end[regs[i]] = (long)pc;
+                }
+        }
+        // anything live somewhere inside a loop has to stay live for the whole loop because the next iteration may read it
+        int changed = 1;
+        while (changed) {
+                changed = 0;
+                for (size_t pc = 0; pc < function->codeLen; pc += op_width(OP(function->code[pc]))) {
+                        if (!is_branch(OP(function->code[pc]))) continue;
+                        long head = (long)branch_target(function, pc), tail = (long)pc;
+                        if (head > tail) continue;
+                        for (int r = 0; r < count; r++) {
+                                if (start[r] < 0 || start[r] > tail || end[r] < head) continue;
+                                if (start[r] > head) { start[r] = head; changed = 1; }
+                                if (end[r] < tail) { end[r] = tail; changed = 1; }
+                        }
+                }
+        }
+
+        // linear scan sort by start then walk the intervals keeping the active ones sorted by end
+        int order[MAX_REGISTERS + 1], active[POOL_LEN], activeCount = 0, n = 0;
+        int available[POOL_LEN], availableCount = POOL_LEN;
+        for (int i = 0; i < POOL_LEN; i++) available[i] = pool[POOL_LEN - 1 - i];
+        for (int r = 0; r < count; r++) if (start[r] >= 0) order[n++] = r;
+        for (int i = 1; i < n; i++) {
+                int r = order[i], j = i;
+                while (j > 0 && start[order[j - 1]] > start[r]) {
+                        order[j] = order[j - 1];
+                        j--;
+                }
+                order[j] = r;
+        }
+        for (int i = 0; i < n; i++) {
+                int r = order[i];
+                // expire intervals that ended before this one starts
+                int kept = 0;
+                for (int j = 0; j < activeCount; j++) {
+                        if (end[active[j]] < start[r]) available[availableCount++] = location[active[j]];
+                        else active[kept++] = active[j];
+                }
+                activeCount = kept;
+
+                if (availableCount > 0) {
+                        location[r] = available[--availableCount];
+                        active[activeCount++] = r;
+                        continue;
+                }
+                // no register left spill whichever interval ends last
+                int victim = 0;
+                for (int j = 1; j < activeCount; j++) if (end[active[j]] > end[active[victim]]) victim = j;
+                if (end[active[victim]] > end[r]) {
+                        location[r] = location[active[victim]];
+                        location[active[victim]] = -1;
+                        active[victim] = r;
+                }
+        }
+}
+
+// three operand int instruction dst = a op b with a in rax and b in rcx
+static void binary(Assembler *as, OpCode op, int dst) {
+        switch (op) {
+                case OP_ADD: op_rr(as, 0x01, RAX, RCX); break;
+                case OP_SUB: op_rr(as, 0x29, RAX, RCX); break;
+                case OP_MUL: imul_rr(as, RAX, RCX); break;
+                case OP_BAND: op_rr(as, 0x21, RAX, RCX); break;
+                case OP_BOR: op_rr(as, 0x09, RAX, RCX); break;
+                case OP_BXOR: op_rr(as, 0x31, RAX, RCX); break;
+                case OP_SHL: unary(as, 0xD3, 4, RAX); break; // the count is masked to 6 bits by the cpu the same as the interpreter does
+                case OP_SHR: unary(as, 0xD3, 7, RAX); break;
+                case OP_EQ: case OP_NE: case OP_LT: case OP_LE: {
+                        op_rr(as, 0x39, RAX, RCX);
+                        setcc(as, op == OP_EQ ? CC_E : op == OP_NE ? CC_NE : op == OP_LT ? CC_L : CC_LE);
+                        break;
+                }
+                case OP_DIV: case OP_MOD: {
+                        // dividing by zero bails so the interpreter reports it and x / -1 is done by hand because LLONG_MIN / -1 traps
+                        op_rr(as, 0x85, RCX, RCX);
+                        jump_bail(as, CC_E);
+                        op_imm(as, 7, RCX, -1);
+                        byte(as, 0x75); // jne over the -1 case
+                        size_t skip = as->len;
+                        byte(as, 0);
+                        if (op == OP_DIV) unary(as, 0xF7, 3, RAX);
+                        else op_rr(as, 0x31, RAX, RAX);
+                        byte(as, 0xEB); // jmp over the idiv
+                        size_t done = as->len;
+                        byte(as, 0);
+                        as->code[skip] = (uint8_t)(as->len - skip - 1);
+                        byte(as, 0x48); // cqo
+                        byte(as, 0x99);
+                        unary(as, 0xF7, 7, RCX);
+                        if (op == OP_MOD) mov_rr(as, RAX, RDX);
+                        as->code[done] = (uint8_t)(as->len - done - 1);
+                        break;
+                }
+                default:
+                        as->ok = 0;
+                        break;
+        }
+        store(as, dst, RAX);
+}
+
+static int negate_cc(int cc) {
+        return cc ^ 1;
+}
+
+static void translate(Assembler *as, const Function *function) {
+        // prologue saves the callee saved registers and loads the arguments
+        for (int i = 0; i < SAVED_LEN; i++) push(as, pool[i]);
+        for (int r = 0; r < function->arity; r++) {
+                if (as->location[r] >= 0) mov_load(as, as->location[r], RDI, slot(r));
+        }
+
+        for (size_t pc = 0; pc < function->codeLen; pc += op_width(OP(function->code[pc]))) {
+                uint32_t ins = function->code[pc];
+                OpCode op = OP(ins);
+                int a = ARG_A(ins), b = ARG_B(ins), c = ARG_C(ins);
+                long long value = 0;
+                as->labels[pc] = as->len;
+
+                switch (op) {
+                        case OP_MOVE:
+                                load(as, RAX, b);
+                                store(as, a, RAX);
+                                break;
+                        case OP_LOADI:
+                                mov_imm(as, RAX, ARG_sBx(ins));
+                                store(as, a, RAX);
+                                break;
+                        case OP_LOADK:
+                                int_constant(function, ARG_Bx(ins), &value);
+                                mov_imm(as, RAX, value);
+                                store(as, a, RAX);
+                                break;
+                        case OP_ADDI:
+                                load(as, RAX, b);
+                                op_imm(as, 0, RAX, ARG_sC(ins));
+                                store(as, a, RAX);
+                                break;
+                        case OP_ADD: case OP_SUB: case OP_MUL: case OP_DIV: case OP_MOD:
+                        case OP_BAND: case OP_BOR: case OP_BXOR: case OP_SHL: case OP_SHR:
+                        case OP_EQ: case OP_NE: case OP_LT: case OP_LE:
+                                load(as, RAX, b);
+                                load(as, RCX, c);
+                                binary(as, op, a);
+                                break;
+                        case OP_ADDK: case OP_SUBK: case OP_MULK: case OP_DIVK: case OP_MODK:
+                                int_constant(function, c, &value);
+                                load(as, RAX, b);
+                                mov_imm(as, RCX, value);
+                                binary(as, OP_ADD + (op - OP_ADDK), a);
+                                break;
+                        case OP_NEG:
+                                load(as, RAX, b);
+                                unary(as, 0xF7, 3, RAX);
+                                store(as, a, RAX);
+                                break;
+                        case OP_NOT:
+                                load(as, RAX, b);
+                                op_rr(as, 0x85, RAX, RAX);
+                                setcc(as, CC_E);
+                                store(as, a, RAX);
+                                break;
+                        case OP_JMP:
+                                jump_to(as, -1, branch_target(function, pc));
+                                break;
+                        case OP_JMPF: case OP_JMPT:
+                                load(as, RAX, a);
+                                op_rr(as, 0x85, RAX, RAX);
+                                jump_to(as, op == OP_JMPF ? CC_E : CC_NE, branch_target(function, pc));
+                                break;
+                        case OP_IFLT: case OP_IFLE: case OP_IFEQ: case OP_IFNE: {
+                                // the superinstructions jump when the comparison is false
+                                int cc = op == OP_IFLT ? CC_L : op == OP_IFLE ? CC_LE : op == OP_IFEQ ? CC_E : CC_NE;
+                                load(as, RAX, a);
+                                load(as, RCX, b);
+                                op_rr(as, 0x39, RAX, RCX);
+                                jump_to(as, negate_cc(cc), branch_target(function, pc));
+                                break;
+                        }
+                        case OP_IFLTK: case OP_IFLEK: case OP_IFGTK: case OP_IFGEK: case OP_IFEQK: case OP_IFNEK: {
+                                int cc = op == OP_IFLTK ? CC_L : op == OP_IFLEK ? CC_LE : op == OP_IFGTK ? CC_G :
+                                         op == OP_IFGEK ? CC_GE : op == OP_IFEQK ? CC_E : CC_NE;
+                                int_constant(function, b, &value);
+                                load(as, RAX, a);
+                                if (value >= INT32_MIN && value <= INT32_MAX) {
+                                        op_imm(as, 7, RAX, (int32_t)value);
+                                } else {
+                                        mov_imm(as, RCX, value);
+                                        op_rr(as, 0x39, RAX, RCX);
+                                }
+                                jump_to(as, negate_cc(cc), branch_target(function, pc));
+                                break;
+                        }
+                        case OP_RETURN:
+                                if (ARG_B(ins)) {
+                                        load(as, RAX, a);
+                                        mov_store(as, RSI, 0, RAX);
+                                        byte(as, 0xB8); // mov eax, JIT_INT
+                                        int32(as, JIT_INT);
+                                } else {
+                                        byte(as, 0xB8);
+                                        int32(as, JIT_NIL);
+                                }
+                                for (int i = SAVED_LEN - 1; i >= 0; i--) pop(as, pool[i]);
+                                byte(as, 0xC3);
+                                break;
+                        default:
+                                as->ok = 0;
+                                break;
+                }
+        }
+
+        // shared bail out stub returns JIT_BAIL so the interpreter runs the call
+        size_t bail = as->len;
+        byte(as, 0x31); // xor eax, eax
+        byte(as, 0xC0);
+        for (int i = SAVED_LEN - 1; i >= 0; i--) pop(as, pool[i]);
+        byte(as, 0xC3);
+
+        for (size_t i = 0; i < as->bailCount; i++) patch32(as, as->bails[i], (int32_t)(bail - (as->bails[i] + 4)));
+        for (size_t i = 0; i < as->fixupCount; i++) {
+                size_t at = as->fixups[i];
+                patch32(as, at, (int32_t)(as->labels[as->targets[i]] - (at + 4)));
+        }
+}
+
+int jit_available(void) {
+        return 1;
+}
+
+int jit_compile(VM *vm, Function *function) {
+        (void)vm;
+        function->jitState = JIT_UNSUPPORTED;
+        if (!supported(function) || function->registers > MAX_REGISTERS) return 0;
+
+        Assembler as;
+        memset(&as, 0, sizeof(as));
+        as.ok = 1;
+        as.labels = calloc(function->codeLen + 1, sizeof(size_t));
+        as.location = malloc(sizeof(int) * (function->registers + 1));
+        if (!as.labels || !as.location) {
+                free(as.labels);
+                free(as.location);
+                return 0;
+        }
+        allocate_registers(function, as.location);
+        translate(&as, function);
+
+        void *memory = MAP_FAILED;
+        size_t size = 0;
+        if (as.ok) {
+                long page = sysconf(_SC_PAGESIZE);
+                size = (as.len + (size_t)page - 1) & ~((size_t)page - 1);
+                memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        // write then flip to read and execute so the page is never writable and executable at the same time
+        if (memory != MAP_FAILED) {
+                memcpy(memory, as.code, as.len);
+                if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+                        munmap(memory, size);
+                        memory = MAP_FAILED;
+                }
+        }
+        free(as.code);
+        free(as.labels);
+        free(as.fixups);
+        free(as.targets);
+        free(as.bails);
+        free(as.location);
+        if (memory == MAP_FAILED) return 0;
+
+        function->jitCode = memory;
+        function->jitSize = size;
+        function->jitState = JIT_COMPILED;
+        return 1;
+}
+
+int jit_call(Function *function, Value *args, Value *result) {
+        for (int i = 0; i < function->arity; i++) {
+                if (args[i].type != VAL_INT) return 0;
+        }
+        // a spilled parameter lives in its argument slot so keep the arguments around in case the call bails half way
+        long long saved[MAX_REGISTERS];
+        for (int i = 0; i < function->arity; i++) saved[i] = args[i].as.i;
+        long long value = 0;
+        JitFn code = (JitFn)function->jitCode;
+        switch (code(args, &value)) {
+                case JIT_INT:
+                        result->type = VAL_INT;
+                        result->as.i = value;
+                        return 1;
+                case JIT_NIL:
+                        result->type = VAL_NIL;
+                        return 1;
+                default:
+                        for (int i = 0; i < function->arity; i++) args[i].as.i = saved[i];
+                        return 0;
+        }
+}
+
+void jit_free(Function *function) {
+        if (function->jitCode) munmap(function->jitCode, function->jitSize);
+        function->jitCode = NULL;
+        function->jitSize = 0;
+}
+
+#else
+
+// anywhere else the JIT is switched off and everything runs in the interpreter
+int jit_available(void) {
+        return 0;
+}
+
+int jit_compile(VM *vm, Function *function) {
+        (void)vm;
+        function->jitState = JIT_UNSUPPORTED;
+        return 0;
+}
+
+int jit_call(Function *function, Value *args, Value *result) {
+        (void)function;
+        (void)args;
+        (void)result;
+        return 0;
+}
+
+void jit_free(Function *function) {
+        (void)function;
+}
+
+#endif
@@ -0,0 +1,28 @@
+// this is the header for the baseline JIT it turns hot functions into x86-64 machine code
+//
+// a function is compiled once it has been called JIT_CALL_THRESHOLD times or its loops have jumped back JIT_LOOP_THRESHOLD
+// times while being interpreted, the machine code is used from the next call on
+// only functions made entirely of int arithmetic, comparisons, branches and returns are compiled (no calls, properties,
+// strings or doubles) anything else stays in the interpreter, the arguments are checked to be ints on every call and if
+// they are not (or something like a division by zero happens) the call just runs in the interpreter instead
+// since those functions cant have side effects running them again from the start in the interpreter is always safe
+
+#ifndef JIT_H
+#define JIT_H
+
+#include "VM.h" // functions and values
+
+#define JIT_CALL_THRESHOLD 100 // calls before a function gets compiled
+#define JIT_LOOP_THRESHOLD 10000 // backwards jumps before a function gets compiled
+
+// true when the JIT can run on this machine (x86-64 Linux)
+int jit_available(void);
+// tries to compile function sets function->jitState to JIT_COMPILED or JIT_UNSUPPORTED and returns 1 when it worked
+int jit_compile(VM *vm, Function *function);
+// runs the machine code for function with its arguments in args
+// returns 1 and sets result when it finished or 0 when the interpreter has to run the call instead
+int jit_call(Function *function, Value *args, Value *result);
+// unmaps the machine code of a function
+void jit_free(Function *function);
+
+#endif
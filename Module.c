@@ -0,0 +1,578 @@
+// here is the module compiler and loader (see Module.h) the .unnc and .unni files are plain little binary formats
+// written through a growable byte buffer and read back with a cursor that checks every read against the end of the file
+
+#include <limits.h> // PATH_MAX for realpath
+#include "Bytecode.h"
+#include "Module.h"
+
+// global table entries in a .unnc file say what the module does with the name, extern is a built in or an import and
+// variable is a top level variable that did not fit in the registers of main
+enum { GLOBAL_EXTERN, GLOBAL_FUNCTION, GLOBAL_CLASS, GLOBAL_VARIABLE };
+
+typedef struct {
+        unsigned char *data;
+        size_t len;
+        size_t cap;
+} Buffer;
+
+typedef struct {
+        const unsigned char *data;
+        size_t len;
+        size_t pos;
+        int ok; // cleared by the first read past the end
+} Reader;
+
+unsigned long long module_hash(const void *data, size_t length, unsigned long long seed) {
+        const unsigned char *bytes = data;
+        unsigned long long hash = seed;
+        for (size_t i = 0; i < length; i++) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+        }
+        return hash;
+}
+
+static void put(Buffer *buffer, const void *data, size_t length) {
+        if (buffer->len + length > buffer->cap) {
+                size_t newCap = buffer->cap ? buffer->cap : 256;
+                while (newCap < buffer->len + length) newCap *= 2;
+                unsigned char *newData = realloc(buffer->data, newCap);
+                if (!newData) {
+                        fprintf(stderr, "BUILD ERROR: Out of memory\n");
+                        exit(1);
+                }
+                buffer->data = newData;
+                buffer->cap = newCap;
+        }
+        memcpy(buffer->data + buffer->len, data, length);
+        buffer->len += length;
+}
+
+static void put_u8(Buffer *buffer, unsigned value) {
+        unsigned char byte = (unsigned char)value;
+        put(buffer, &byte, 1);
+}
+
+static void put_u32(Buffer *buffer, uint32_t value) {
+        put(buffer, &value, sizeof(value));
+}
+
+// strings are stored with their length and a '\0' so the loader can use them straight out of the file
+static void put_string(Buffer *buffer, const char *text) {
+        uint32_t length = (uint32_t)strlen(text);
+        put_u32(buffer, length);
+        put(buffer, text, length + 1);
+}
+
+static const void *get(Reader *reader, size_t length) {
+        if (!reader->ok || length > reader->len - reader->pos) {
+                reader->ok = 0;
+                return NULL;
+        }
+        const void *data = reader->data + reader->pos;
+        reader->pos += length;
+        return data;
+}
+
+static unsigned get_u8(Reader *reader) {
+        const unsigned char *byte = get(reader, 1);
+        return byte ? *byte : 0;
+}
+
+static uint32_t get_u32(Reader *reader) {
+        uint32_t value = 0;
+        const void *data = get(reader, sizeof(value));
+        if (data) memcpy(&value, data, sizeof(value));
+        return value;
+}
+
+static const char *get_string(Reader *reader) {
+        uint32_t length = get_u32(reader);
+        const char *text = get(reader, (size_t)length + 1);
+        if (text && text[length] != '\0') reader->ok = 0;
+        return reader->ok ? text : "";
+}
+
+static int write_file(const char *path, const void *data, size_t length) {
+        // write next to the real file and rename so a crash never leaves half a file behind
+        char temp[PATH_MAX + 8];
+        snprintf(temp, sizeof(temp), "%s.tmp", path);
+        FILE *file = fopen(temp, "wb");
+        if (!file) return 0;
+        int ok = fwrite(data, 1, length, file) == length;
+        ok = fclose(file) == 0 && ok;
+        if (ok) ok = rename(temp, path) == 0;
+        if (!ok) remove(temp);
+        return ok;
+}
+
+size_t module_scan_imports(const char *source, char ***paths) {
+        size_t count = 0, cap = 0;
+        *paths = NULL;
+        const char *p = source;
+        while (1) {
+                while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') p++;
+                if (p[0] == '/' && (p[1] == '/' || p[1] == '*')) {
+                        // comments get skipped the same way the lexer skips them, an unclosed one is left for it to report
+                        int closed;
+                        p += comment_length(p, &closed);
+                        if (!closed) break;
+                        continue;
+                }
+                if (strncmp(p, "import", 6) != 0 || isalnum((unsigned char)p[6]) || p[6] == '_') break;
+                const char *q = p + 6;
+                while (*q == ' ' || *q == '\t') q++;
+                if (*q != '"') break;
+                // same escapes as the string DFA
+                const char *start = ++q;
+                while (*q && *q != '"' && *q != '\n') q += (q[0] == '\\' && q[1]) ? 2 : 1;
+                if (*q != '"') break;
+
+                char *path = malloc((size_t)(q - start) + 1);
+                size_t len = 0;
+                for (const char *c = start; c < q; c++) {
+                        if (*c == '\\' && c + 1 < q) c++;
+                        path[len++] = *c;
+                }
+                path[len] = '\0';
+                if (count >= cap) {
+                        cap = cap ? cap * 2 : 8;
+                        *paths = realloc(*paths, sizeof(char *) * cap);
+                }
+                (*paths)[count++] = path;
+
+                p = q + 1;
+                while (*p == ' ' || *p == '\t') p++;
+                if (*p == ';') p++;
+        }
+        return count;
+}
+
+char *module_resolve(const char *from, const char *path) {
+        char joined[PATH_MAX];
+        const char *slash = strrchr(from, '/');
+        int dirLen = path[0] == '/' || !slash ? 0 : (int)(slash - from + 1);
+        size_t len = strlen(path);
+        const char *extension = len >= 4 && strcmp(path + len - 4, ".unn") == 0 ? "" : ".unn";
+        if (snprintf(joined, sizeof(joined), "%.*s%s%s", dirLen, from, path, extension) >= (int)sizeof(joined)) return NULL;
+        char resolved[PATH_MAX];
+        if (!realpath(joined, resolved)) return NULL;
+        return strdup(resolved);
+}
+
+static int compare_exports(const void *a, const void *b) {
+        return strcmp(((const Export *)a)->name, ((const Export *)b)->name);
+}
+
+static void interface_bytes(const Interface *iface, Buffer *buffer) {
+        put_u32(buffer, INTERFACE_MAGIC);
+        put_u32(buffer, MODULE_VERSION);
+        put_u32(buffer, (uint32_t)iface->count);
+        for (size_t i = 0; i < iface->count; i++) {
+                put_u8(buffer, iface->exports[i].kind);
+                put_u32(buffer, (uint32_t)iface->exports[i].arity);
+                put_string(buffer, iface->exports[i].name);
+        }
+}
+
+int interface_write(const char *path, const Interface *iface) {
+        Buffer buffer = {0};
+        interface_bytes(iface, &buffer);
+        int ok = write_file(path, buffer.data, buffer.len);
+        free(buffer.data);
+        return ok;
+}
+
+int interface_read(const char *path, Interface *iface) {
+        size_t length = 0;
+        char *data = read_source(path, &length);
+        memset(iface, 0, sizeof(Interface));
+        if (!data) return 0;
+        Reader reader = {(const unsigned char *)data, length, 0, 1};
+        int ok = get_u32(&reader) == INTERFACE_MAGIC && get_u32(&reader) == MODULE_VERSION;
+        uint32_t count = ok ? get_u32(&reader) : 0;
+        if (ok && count <= length) {
+                iface->exports = calloc(count + 1, sizeof(Export));
+                for (uint32_t i = 0; i < count && reader.ok; i++) {
+                        iface->exports[i].kind = get_u8(&reader) == EXPORT_CLASS ? EXPORT_CLASS : EXPORT_FUNCTION;
+                        iface->exports[i].arity = (int)get_u32(&reader);
+                        iface->exports[i].name = strdup(get_string(&reader));
+                        iface->count++;
+                }
+        }
+        ok = ok && reader.ok && iface->count == count;
+        if (ok) iface->hash = module_hash(data, length, MODULE_HASH_SEED);
+        else interface_free(iface);
+        free(data);
+        return ok;
+}
+
+void interface_free(Interface *iface) {
+        for (size_t i = 0; i < iface->count; i++) free(iface->exports[i].name);
+        free(iface->exports);
+        memset(iface, 0, sizeof(Interface));
+}
+
+// index of a function or class in the vm that compiled the module which is how the object file refers to them
+static uint32_t function_index(const VM *vm, const Function *function) {
+        for (size_t i = 0; i < vm->functionCount; i++) if (vm->functions[i] == function) return (uint32_t)i;
+        return 0;
+}
+
+static uint32_t class_index(const VM *vm, const Class *klass) {
+        for (size_t i = 0; i < vm->classCount; i++) if (vm->classes[i] == klass) return (uint32_t)i;
+        return 0;
+}
+
+static int is_exported(const Node *program, const char *name) {
+        for (const Node *node = program->body; node; node = node->next) {
+                if ((node->flags & NODE_EXPORT) && strcmp(node->name, name) == 0) return 1;
+        }
+        return 0;
+}
+
+// the layout is symbols, globals, classes, functions, index of main and a hash, the loader reads it back in the same order
+static void object_bytes(const VM *vm, const Node *program, const Function *main, Buffer *buffer) {
+        put_u32(buffer, MODULE_MAGIC);
+        put_u32(buffer, MODULE_VERSION);
+
+        put_u32(buffer, (uint32_t)vm->symbols->count);
+        for (size_t i = 0; i < vm->symbols->count; i++) put_string(buffer, vm->symbols->names[i]);
+
+        put_u32(buffer, (uint32_t)vm->globalCount);
+        for (size_t i = 0; i < vm->globalCount; i++) {
+                const Value *value = &vm->globals[i];
+                const char *name = symbol_name(vm->symbols, vm->globalNames[i]);
+                int variable = strncmp(name, MAIN_VARIABLE_PREFIX, strlen(MAIN_VARIABLE_PREFIX)) == 0;
+                put_u32(buffer, (uint32_t)vm->globalNames[i]);
+                if (value->type == VAL_FUNCTION) {
+                        put_u8(buffer, GLOBAL_FUNCTION);
+                        put_u32(buffer, function_index(vm, value->as.function));
+                } else if (value->type == VAL_CLASS) {
+                        put_u8(buffer, GLOBAL_CLASS);
+                        put_u32(buffer, class_index(vm, value->as.klass));
+                } else if (variable) {
+                        put_u8(buffer, GLOBAL_VARIABLE);
+                        put_u32(buffer, 0);
+                } else {
+                        put_u8(buffer, GLOBAL_EXTERN);
+                        put_u32(buffer, 0);
+                }
+                // top level variables are private to the module like anything it does not export
+                put_u8(buffer, variable || ((value->type == VAL_FUNCTION || value->type == VAL_CLASS) && !is_exported(program, name)));
+        }
+
+        put_u32(buffer, (uint32_t)vm->classCount);
+        for (size_t i = 0; i < vm->classCount; i++) {
+                const Class *klass = vm->classes[i];
+                put_u32(buffer, (uint32_t)klass->name);
+                put_u32(buffer, klass->parent ? class_index(vm, klass->parent) + 1 : 0);
+                put_u32(buffer, function_index(vm, klass->constructor));
+                put_u32(buffer, (uint32_t)klass->shape->slotCount);
+                for (int slot = 0; slot < klass->shape->slotCount; slot++) put_u32(buffer, (uint32_t)klass->shape->names[slot]);
+                put_u32(buffer, (uint32_t)klass->methodCount);
+                for (int m = 0; m < klass->methodCount; m++) {
+                        put_u32(buffer, (uint32_t)klass->methodNames[m]);
+                        put_u32(buffer, function_index(vm, klass->methods[m]));
+                }
+        }
+
+        put_u32(buffer, (uint32_t)vm->functionCount);
+        for (size_t i = 0; i < vm->functionCount; i++) {
+                const Function *function = vm->functions[i];
+                put_u32(buffer, (uint32_t)function->name);
+                put_u32(buffer, (uint32_t)function->arity);
+                put_u32(buffer, (uint32_t)function->registers);
+                put_u8(buffer, function->isMethod);
+                put_u8(buffer, function->isConstructor);
+                put_u32(buffer, (uint32_t)function->codeLen);
+                put(buffer, function->code, sizeof(uint32_t) * function->codeLen);
+                for (size_t pc = 0; pc < function->codeLen; pc++) put_u32(buffer, (uint32_t)function->lines[pc]);
+                put_u32(buffer, (uint32_t)function->constCount);
+                for (size_t k = 0; k < function->constCount; k++) {
+                        const Value *value = &function->constants[k];
+                        put_u8(buffer, value->type);
+                        if (value->type == VAL_STRING) put_string(buffer, value->as.string->chars);
+                        else put(buffer, &value->as.i, sizeof(value->as.i)); // ints and doubles are both 8 bytes
+                }
+                put_u32(buffer, (uint32_t)function->cacheCount);
+                for (size_t k = 0; k < function->cacheCount; k++) put_u32(buffer, (uint32_t)function->caches[k].name);
+        }
+        put_u32(buffer, function_index(vm, main));
+        // the bytecode is trusted by the vm so a hash of everything before it catches files that got damaged on disk
+        unsigned long long hash = module_hash(buffer->data, buffer->len, MODULE_HASH_SEED);
+        put(buffer, &hash, sizeof(hash));
+}
+
+int module_compile(const char *path, const char *source, const Interface *imports, size_t importCount, const char *objectPath, Interface *out) {
+        memset(out, 0, sizeof(Interface));
+        size_t count = 0;
+        TrieNode *keywords = lexer_keywords();
+        Token *tokens = lexer_run_stripped((char *)source, &count, keywords, NULL);
+        freeTrie(keywords);
+        if (!tokens) return 0;
+
+        Arena arena;
+        Parser parser;
+        arena_init(&arena);
+        parser_init(&parser, tokens, count, &arena);
+        Node *program = parse_program(&parser);
+        int ok = print_diagnostics(parser.diags, parser.diagCount) == 0;
+        parser_free(&parser);
+
+        // the exports of every import become globals so the compiler can resolve them, their values never get used
+        VM vm;
+        vm_init(&vm);
+        const Node *importNode = program->body;
+        for (size_t i = 0; ok && i < importCount; i++) {
+                while (importNode && importNode->type != NODE_IMPORT) importNode = importNode->next;
+                for (size_t e = 0; e < imports[i].count; e++) {
+                        const char *name = imports[i].exports[e].name;
+                        if (vm_find_global(&vm, name) >= 0) {
+                                fprintf(error_stream(), "SEMANTIC ERROR: '%s' is imported more than once \nLINE : %lu, COL : %lu\n", name,
+                                        importNode ? importNode->line : 0, importNode ? importNode->col : 0);
+                                ok = 0;
+                        } else vm_global(&vm, name);
+                }
+                if (importNode) importNode = importNode->next;
+        }
+        Function *main = ok ? compile_program(&vm, program) : NULL;
+
+        if (main) {
+                for (const Node *node = program->body; node; node = node->next) out->count += (node->flags & NODE_EXPORT) != 0;
+                out->exports = calloc(out->count + 1, sizeof(Export));
+                size_t e = 0;
+                for (const Node *node = program->body; node; node = node->next) {
+                        if (!(node->flags & NODE_EXPORT)) continue;
+                        Value *value = &vm.globals[vm_find_global(&vm, node->name)];
+                        out->exports[e].name = strdup(node->name);
+                        out->exports[e].kind = value->type == VAL_CLASS ? EXPORT_CLASS : EXPORT_FUNCTION;
+                        out->exports[e++].arity = value->type == VAL_CLASS ? value->as.klass->constructor->arity : value->as.function->arity;
+                }
+                qsort(out->exports, out->count, sizeof(Export), compare_exports);
+                Buffer buffer = {0};
+                interface_bytes(out, &buffer);
+                out->hash = module_hash(buffer.data, buffer.len, MODULE_HASH_SEED);
+                buffer.len = 0;
+
+                object_bytes(&vm, program, main, &buffer);
+                if (!write_file(objectPath, buffer.data, buffer.len)) {
+                        fprintf(error_stream(), "BUILD ERROR: Could not write '%s' for '%s'\n", objectPath, path);
+                        interface_free(out);
+                        main = NULL;
+                }
+                free(buffer.data);
+        }
+
+        vm_free(&vm);
+        arena_free(&arena);
+        free(tokens);
+        return main != NULL;
+}
+
+// reads a symbol id of the module and turns it into the matching symbol of the vm
+static int get_symbol(Reader *reader, const int *symbols, uint32_t symbolCount) {
+        uint32_t id = get_u32(reader);
+        if (id < symbolCount) return symbols[id];
+        reader->ok = 0;
+        return 0;
+}
+
+static Function *link_error(const char *message, const char *name, const char *path) {
+        fprintf(stderr, "LINK ERROR: ");
+        fprintf(stderr, message, name);
+        fprintf(stderr, " \nMODULE : %s\n", path);
+        return NULL;
+}
+
+Function *module_load(VM *vm, const char *objectPath, const char *path) {
+        size_t length = 0;
+        char *data = read_source(objectPath, &length);
+        if (!data) return link_error("Missing object file '%s' build the program again", objectPath, path);
+        unsigned long long hash = 0;
+        if (length >= sizeof(hash)) {
+                length -= sizeof(hash);
+                memcpy(&hash, data + length, sizeof(hash));
+        }
+        Reader reader = {(const unsigned char *)data, length, 0, hash == module_hash(data, length, MODULE_HASH_SEED)};
+        Function *main = NULL;
+        int *symbols = NULL, *slots = NULL;
+        Class **classes = NULL;
+        Function **functions = NULL;
+        uint32_t *constructors = NULL;
+
+        if (get_u32(&reader) != MODULE_MAGIC || get_u32(&reader) != MODULE_VERSION) goto damaged;
+
+        // symbol ids of the module become symbol ids of this vm
+        uint32_t symbolCount = get_u32(&reader);
+        if (symbolCount > length) goto damaged;
+        symbols = malloc(sizeof(int) * (symbolCount + 1));
+        for (uint32_t i = 0; i < symbolCount && reader.ok; i++) symbols[i] = symbol_intern(vm->symbols, get_string(&reader));
+
+        // globals of the module become globals of this vm private ones get the module path in front of them
+        uint32_t globalCount = get_u32(&reader);
+        if (globalCount > length) goto damaged;
+        slots = malloc(sizeof(int) * (globalCount + 1));
+        uint32_t *kinds = malloc(sizeof(uint32_t) * 2 * (globalCount + 1)), *indices = kinds + globalCount + 1;
+        for (uint32_t i = 0; i < globalCount && reader.ok; i++) {
+                const char *name = symbol_name(vm->symbols, get_symbol(&reader, symbols, symbolCount));
+                kinds[i] = get_u8(&reader);
+                indices[i] = get_u32(&reader);
+                if (get_u8(&reader)) {
+                        char mangled[PATH_MAX + 256];
+                        snprintf(mangled, sizeof(mangled), "%s:%s", path, name);
+                        slots[i] = vm_global(vm, mangled);
+                } else slots[i] = vm_global(vm, name);
+                if (slots[i] > 0xFFFF) {
+                        free(kinds);
+                        link_error("Too many globals to load '%s'", name, path);
+                        goto done;
+                }
+        }
+
+        uint32_t classCount = get_u32(&reader);
+        if (classCount > length) goto damaged_globals;
+        classes = malloc(sizeof(Class *) * (classCount + 1));
+        constructors = malloc(sizeof(uint32_t) * (classCount + 1));
+        size_t classStart = reader.pos;
+        // classes first so their constructors (made by vm_new_class) can be filled in with the saved code below
+        for (uint32_t i = 0; i < classCount && reader.ok; i++) {
+                classes[i] = vm_new_class(vm, symbol_name(vm->symbols, get_symbol(&reader, symbols, symbolCount)));
+                get_u32(&reader);
+                constructors[i] = get_u32(&reader);
+                uint32_t slotCount = get_u32(&reader);
+                get(&reader, sizeof(uint32_t) * (size_t)slotCount);
+                uint32_t methodCount = get_u32(&reader);
+                get(&reader, sizeof(uint32_t) * 2 * (size_t)methodCount);
+        }
+
+        uint32_t functionCount = get_u32(&reader);
+        if (functionCount > length || !reader.ok) goto damaged_globals;
+        functions = calloc(functionCount + 1, sizeof(Function *));
+        for (uint32_t i = 0; i < classCount; i++) {
+                if (constructors[i] >= functionCount) goto damaged_globals;
+                functions[constructors[i]] = classes[i]->constructor;
+        }
+        for (uint32_t i = 0; i < functionCount && reader.ok; i++) {
+                int name = get_symbol(&reader, symbols, symbolCount);
+                Function *function = functions[i] ? functions[i] : vm_new_function(vm, symbol_name(vm->symbols, name));
+                functions[i] = function;
+                function->arity = (int)get_u32(&reader);
+                function->registers = (int)get_u32(&reader);
+                function->isMethod = (int)get_u8(&reader);
+                function->isConstructor = (int)get_u8(&reader);
+                uint32_t codeLen = get_u32(&reader);
+                const void *code = get(&reader, sizeof(uint32_t) * (size_t)codeLen);
+                if (!code) break;
+                function->code = malloc(sizeof(uint32_t) * (codeLen + 1));
+                function->lines = malloc(sizeof(size_t) * (codeLen + 1));
+                memcpy(function->code, code, sizeof(uint32_t) * codeLen);
+                function->codeLen = function->codeCap = codeLen;
+                for (uint32_t pc = 0; pc < codeLen; pc++) function->lines[pc] = get_u32(&reader);
+                for (uint32_t pc = 0; pc < codeLen; pc += op_width(OP(function->code[pc]))) {
+                        uint32_t ins = function->code[pc];
+                        int global = OP(ins) == OP_GETGLOBAL || OP(ins) == OP_SETGLOBAL;
+                        if (OP(ins) >= OP_COUNT || (global && ARG_Bx(ins) >= globalCount)) reader.ok = 0;
+                        else if (global) function->code[pc] = ENCODE_ABx(OP(ins), ARG_A(ins), slots[ARG_Bx(ins)]);
+                }
+
+                uint32_t constCount = get_u32(&reader);
+                if (constCount > length) {
+                        reader.ok = 0;
+                        break;
+                }
+                function->constants = malloc(sizeof(Value) * (constCount + 1));
+                function->constCount = function->constCap = constCount;
+                for (uint32_t k = 0; k < constCount && reader.ok; k++) {
+                        Value *value = &function->constants[k];
+                        value->type = (ValueType)get_u8(&reader);
+                        if (value->type == VAL_STRING) {
+                                const char *text = get_string(&reader);
+                                *value = vm_string(vm, text, strlen(text));
+                        } else if (value->type != VAL_INT && value->type != VAL_DOUBLE) {
+                                reader.ok = 0;
+                        } else {
+                                const void *bits = get(&reader, sizeof(value->as.i));
+                                if (bits) memcpy(&value->as.i, bits, sizeof(value->as.i));
+                        }
+                }
+                uint32_t cacheCount = get_u32(&reader);
+                if (cacheCount > length) {
+                        reader.ok = 0;
+                        break;
+                }
+                function->caches = calloc(cacheCount + 1, sizeof(InlineCache));
+                function->cacheCount = function->cacheCap = cacheCount;
+                for (uint32_t k = 0; k < cacheCount && reader.ok; k++) function->caches[k].name = get_symbol(&reader, symbols, symbolCount);
+        }
+        uint32_t mainIndex = get_u32(&reader);
+        if (!reader.ok || mainIndex >= functionCount) goto damaged_globals;
+
+        // now that every function exists go back over the classes for their parents shapes and methods
+        size_t functionsEnd = reader.pos;
+        reader.pos = classStart;
+        for (uint32_t i = 0; i < classCount && reader.ok; i++) {
+                Class *klass = classes[i];
+                get_u32(&reader);
+                uint32_t parent = get_u32(&reader);
+                if (parent > classCount) reader.ok = 0;
+                else if (parent) klass->parent = classes[parent - 1];
+                get_u32(&reader);
+                uint32_t slotCount = get_u32(&reader);
+                for (uint32_t slot = 0; slot < slotCount && reader.ok; slot++) klass->shape = shape_add(klass->shape, get_symbol(&reader, symbols, symbolCount));
+                uint32_t methodCount = get_u32(&reader);
+                klass->methodNames = malloc(sizeof(int) * (methodCount + 1));
+                klass->methods = malloc(sizeof(Function *) * (methodCount + 1));
+                for (uint32_t m = 0; m < methodCount && reader.ok; m++) {
+                        klass->methodNames[m] = get_symbol(&reader, symbols, symbolCount);
+                        uint32_t index = get_u32(&reader);
+                        if (index >= functionCount) reader.ok = 0;
+                        else klass->methods[klass->methodCount++] = functions[index];
+                }
+        }
+        reader.pos = functionsEnd;
+        if (!reader.ok) goto damaged_globals;
+
+        // finally define the globals the module owns and check the ones it needs are there
+        for (uint32_t i = 0; i < globalCount; i++) {
+                Value *value = &vm->globals[slots[i]];
+                const char *name = symbol_name(vm->symbols, vm->globalNames[slots[i]]);
+                if (kinds[i] == GLOBAL_EXTERN) {
+                        if (value->type == VAL_NIL) {
+                                free(kinds);
+                                link_error("'%s' is not exported by any module loaded before this one", name, path);
+                                goto done;
+                        }
+                        continue;
+                }
+                if (kinds[i] == GLOBAL_VARIABLE) continue; // nil until main stores into it
+                if (value->type != VAL_NIL) {
+                        free(kinds);
+                        link_error("'%s' is exported by more than one module", name, path);
+                        goto done;
+                }
+                if (kinds[i] == GLOBAL_FUNCTION && indices[i] < functionCount) {
+                        value->type = VAL_FUNCTION;
+                        value->as.function = functions[indices[i]];
+                } else if (kinds[i] == GLOBAL_CLASS && indices[i] < classCount) {
+                        value->type = VAL_CLASS;
+                        value->as.klass = classes[indices[i]];
+                } else goto damaged_globals;
+        }
+        free(kinds);
+        main = functions[mainIndex];
+        goto done;
+
+damaged_globals:
+        free(kinds);
+damaged:
+        link_error("'%s' is damaged build the program again", objectPath, path);
+done:
+        free(symbols);
+        free(slots);
+        free(classes);
+        free(constructors);
+        free(functions);
+        free(data);
+        return main;
+}
@@ -0,0 +1,59 @@
+// this is the header for modules, a .unn file can import other files with import "path" at the very top and
+// make functions and classes visible to them with export define / export class
+//
+// every module is compiled on its own into two files in the build directory (see Build.h)
+//   .unnc  the bytecode of the module with its names kept as strings so it can be loaded into any vm
+//   .unni  the interface, just the exported names with their kind and arity sorted by name
+// a module only ever looks at the interfaces of the modules it imports so it only has to be compiled again when its own
+// source or one of those interfaces changed
+//
+// all modules share one global namespace when they run, names a module does not export are renamed to path:name when it is
+// loaded so two modules can have private helpers with the same name, exported names have to be unique across the program
+
+#ifndef MODULE_H
+#define MODULE_H
+
+#include "Parser.h" // AST for the import list and export flags
+#include "VM.h" // functions and classes that get saved and loaded
+
+#define MODULE_MAGIC 0x434E4E55u // "UNNC" at the start of every .unnc file
+#define INTERFACE_MAGIC 0x494E4E55u // "UNNI" at the start of every .unni file
+#define MODULE_VERSION 2 // bumped whenever the .unnc layout changes so old build directories get rebuilt
+
+typedef enum { EXPORT_FUNCTION, EXPORT_CLASS } ExportKind;
+
+typedef struct {
+        char *name;
+        ExportKind kind;
+        int arity; // parameters of the function or of the class constructor
+} Export;
+
+typedef struct {
+        Export *exports; // sorted by name
+        size_t count;
+        unsigned long long hash; // hash of the interface file contents
+} Interface;
+
+// 64 bit FNV-1a used for source and interface hashes, seed with MODULE_HASH_SEED or a previous hash to chain them
+#define MODULE_HASH_SEED 14695981039346656037ull
+unsigned long long module_hash(const void *data, size_t length, unsigned long long seed);
+
+// finds the import "path" lines at the top of source without running the lexer (imports have to come first so this is exact,
+// comments around them are skipped with the same comment_length the lexer uses)
+// returns how many there were and sets *paths to a malloced array of malloced strings
+size_t module_scan_imports(const char *source, char ***paths);
+// turns an import path into the path of the file relative to the directory of the importing file (.unn is added if missing)
+char *module_resolve(const char *from, const char *path);
+
+// compiles source into the object file objectPath checking names against the interfaces of the imports
+// fills out with the exports and returns 1 or prints the errors and returns 0
+int module_compile(const char *path, const char *source, const Interface *imports, size_t importCount, const char *objectPath, Interface *out);
+// loads an object file into vm linking its globals by name and returns its <main> or NULL after printing an error
+Function *module_load(VM *vm, const char *objectPath, const char *path);
+
+// reads and writes .unni files returning 1 when it worked
+int interface_write(const char *path, const Interface *iface);
+int interface_read(const char *path, Interface *iface);
+void interface_free(Interface *iface);
+
+#endif
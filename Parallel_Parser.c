@@ -0,0 +1,175 @@
+// here is the parallel parser (see Parallel_Parser.h) the workers all run the normal recursive descent parser
+// on their own range of tokens so all the real parsing stays in Parser.c
+
+#include <pthread.h> // worker threads
+#include <unistd.h> // sysconf for the number of cores
+#include "Parallel_Parser.h"
+
+// a run of whole top level declarations parsed by one worker
+typedef struct {
+        size_t start; // first token (comments skipped)
+        size_t end; // one past the last token
+        Arena arena; // nodes of this unit until they get spliced into the main arena
+        Node *head; // statements of this unit linked through next
+        Node **tail;
+        int failed; // had syntax errors so it gets parsed again sequentially
+} Unit;
+
+typedef struct {
+        Token *tokens;
+        Unit *units;
+        size_t unitCount;
+        size_t nextUnit; // next unit nobody has taken yet
+        pthread_mutex_t lock;
+} Work;
+
+int parallel_default_jobs(void) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        return cores > 0 ? (int)cores : 1;
+}
+
+static size_t skip_comments(const Token *tokens, size_t i, size_t count) {
+        while (i < count && (tokens[i].type == SLCOMMENT || tokens[i].type == MLCOMMENT)) i++;
+        return i;
+}
+
+void decl_scan_init(DeclScan *scan) {
+        memset(scan, 0, sizeof(DeclScan));
+}
+
+int decl_scan(DeclScan *scan, const Token *tokens, size_t count, size_t *next) {
+        while (1) {
+                if (scan->pending) {
+                        size_t i = skip_comments(tokens, scan->pos, count);
+                        if (i >= count) return 0;
+                        scan->pending = 0;
+                        scan->pos = i;
+                        // if (x) y; else z and do { } while (x) keep going after the ; or } and so does a } that closes nothing
+                        // because parse_top_level reports that one along with the statement in front of it
+                        if (tokens[i].type != ELSE && tokens[i].type != WHILE && tokens[i].type != CLOSEC) {
+                                *next = i;
+                                return 1;
+                        }
+                }
+                if (scan->pos >= count) return 0;
+                switch (tokens[scan->pos++].type) {
+                        case OPENC: scan->braces++; break;
+                        case CLOSEC:
+                                // a } with no { before it is an error that the parser reports so it never ends anything
+                                if (scan->braces == 0) break;
+                                scan->braces--;
+                                scan->pending = scan->braces == 0 && scan->nested == 0;
+                                break;
+                        case OPENP: case OPENB: scan->nested++; break;
+                        case CLOSEP: case CLOSEB: if (scan->nested > 0) scan->nested--; break;
+                        case SEMI: scan->pending = scan->braces == 0 && scan->nested == 0; break;
+                        default: break;
+                }
+        }
+}
+
+// groups the declarations decl_scan finds into units of at least target tokens
+// returns the number of units (0 if the array could not be allocated)
+static size_t split_units(Token *tokens, size_t count, size_t target, Unit **out) {
+        size_t cap = count / target + 2, unitCount = 0;
+        Unit *units = malloc(sizeof(Unit) * cap);
+        if (!units) return 0;
+
+        DeclScan scan;
+        decl_scan_init(&scan);
+        size_t start = skip_comments(tokens, 0, count), next;
+        while (decl_scan(&scan, tokens, count, &next)) {
+                if (next - start < target || unitCount + 1 >= cap) continue;
+                units[unitCount].start = start;
+                units[unitCount++].end = next;
+                start = next;
+        }
+        if (start < count) {
+                units[unitCount].start = start;
+                units[unitCount++].end = count;
+        }
+        *out = units;
+        return unitCount;
+}
+
+static void parse_unit(Token *tokens, Unit *unit) {
+        Parser parser;
+        arena_init(&unit->arena);
+        parser_init_range(&parser, tokens, unit->start, unit->end, &unit->arena);
+        unit->head = NULL;
+        unit->tail = &unit->head;
+        while (parser.pos < parser.count) parse_top_level(&parser, &unit->tail);
+        unit->failed = parser.diagCount > 0 || parser.panic;
+        parser_free(&parser);
+}
+
+// every worker (and the main thread) keeps taking the next unit until there are none left
+static void *worker(void *arg) {
+        Work *work = arg;
+        while (1) {
+                pthread_mutex_lock(&work->lock);
+                size_t index = work->nextUnit++;
+                pthread_mutex_unlock(&work->lock);
+                if (index >= work->unitCount) return NULL;
+                parse_unit(work->tokens, &work->units[index]);
+        }
+}
+
+Node *parse_program_parallel(Parser *parser, int jobs) {
+        size_t count = parser->count;
+        if (jobs < 1) jobs = 1;
+        size_t target = count / ((size_t)jobs * 4);
+        if (target < PARALLEL_UNIT_TOKENS) target = PARALLEL_UNIT_TOKENS;
+
+        Unit *units = NULL;
+        size_t unitCount = jobs > 1 ? split_units(parser->tokens, count, target, &units) : 0;
+        if (unitCount < 2) {
+                // not enough work to be worth starting threads for
+                free(units);
+                return parse_program(parser);
+        }
+
+        Work work;
+        work.tokens = parser->tokens;
+        work.units = units;
+        work.unitCount = unitCount;
+        work.nextUnit = 0;
+        pthread_mutex_init(&work.lock, NULL);
+        int threadCount = jobs - 1 < (int)unitCount - 1 ? jobs - 1 : (int)unitCount - 1;
+        pthread_t *threads = malloc(sizeof(pthread_t) * threadCount);
+        int started = 0;
+        while (threads && started < threadCount && pthread_create(&threads[started], NULL, worker, &work) == 0) started++;
+        worker(&work);
+        for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+        free(threads);
+        pthread_mutex_destroy(&work.lock);
+
+        // stitch the units together in source order
+        Node *program = new_program(parser);
+        Node **tail = &program->body;
+        size_t u = 0;
+        while (u < unitCount) {
+                Unit *unit = &units[u];
+                if (!unit->failed) {
+                        if (unit->head) {
+                                *tail = unit->head;
+                                tail = unit->tail;
+                        }
+                        u++;
+                        continue;
+                }
+                // go back to the sequential parser until it lands exactly on the start of a later unit with nothing pending
+                size_t from = u;
+                parser->pos = unit->start;
+                parser->panic = 0;
+                do {
+                        parse_top_level(parser, &tail);
+                        while (u < unitCount && units[u].start < parser->pos) u++;
+                } while (parser->pos < count && !(u > from && u < unitCount && units[u].start == parser->pos && !parser->panic));
+        }
+
+        // the nodes of units that were parsed again are never linked in but their memory goes with the rest
+        for (size_t i = 0; i < unitCount; i++) arena_splice(parser->arena, &units[i].arena);
+        free(units);
+        return program;
+}
@@ -0,0 +1,40 @@
+// this is the header for the parallel parser it parses one big file on several threads
+//
+// the token stream is scanned once for the places a top level declaration ends: a ; or a } with every (, [ and { before it
+// closed (a ; or } followed by else or while is skipped since the statement keeps going and so is one followed by a } that
+// closes nothing since that error belongs to the statement before it), the declarations between those
+// places are grouped into units of about the same size and every unit is parsed by a worker into its own arena
+// the arenas are then spliced into the main one and the statement lists linked up in order so nothing gets copied
+//
+// a unit with syntax errors is parsed again sequentially from its start (error recovery can run past the end of a unit)
+// until the parser lands on the start of a later unit that parsed cleanly, so the tree and the diagnostics always come out
+// exactly the same as parse_program and in source order
+
+#ifndef PARALLEL_PARSER_H
+#define PARALLEL_PARSER_H
+
+#include "Parser.h" // the sequential parser every worker runs
+
+#ifndef PARALLEL_UNIT_TOKENS
+#define PARALLEL_UNIT_TOKENS 2048 // smallest amount of tokens worth handing to a worker
+#endif
+
+// how far the search for the ends of top level declarations got so tokens can be scanned as they come in (Pipeline.c)
+typedef struct {
+        size_t pos; // next token to look at
+        int braces;
+        int nested; // ( and [
+        int pending; // the token before pos ends a declaration unless the next one is else or while
+} DeclScan;
+
+void decl_scan_init(DeclScan *scan);
+// scans tokens[0 .. count) from where the last call stopped, returns 1 with *next set to where the next declaration starts
+// as soon as one is known to be finished and 0 when it needs more tokens to tell
+int decl_scan(DeclScan *scan, const Token *tokens, size_t count, size_t *next);
+
+// number of cores to use when the driver is not told how many jobs to run
+int parallel_default_jobs(void);
+// parses parser->tokens like parse_program using up to jobs threads nodes go into parser->arena and errors into parser->diags
+Node *parse_program_parallel(Parser *parser, int jobs);
+
+#endif
@@ -1,42 +1,711 @@
-#include <stdio.h> // standard i/o lib for C
-#include <stdlib.h> // standard lib for C
-#include <ctype.h> // lib for char type functions like isdigit()
-#include <string.h> // lib for string functions like strcmp()
-
-// reading the file into a buffer with error handling and passing the entire file as a self containe string within the program
-// to the main lexer method just for ease of navigation instead of being forced to reference the characters via fgetc we can
-// simply navigate as if it was a string contained within the program
-int main() {
-        // Dynamic memory allocation for input
-        char *input = NULL;
-        size_t len = 0;
-        size_t read;
-
-        // Open the file for reading
-        FILE *file = fopen("test.unn", "r");
-        if (!file) {
-                perror("Could not open file");
-                return 1; // Exit if the file cannot be opened
-        }
-
-        // Read the entire file into a buffer
-        fseek(file, 0, SEEK_END); // Go to the end of the file
-        len = ftell(file); // Get the file size
-        fseek(file, 0, SEEK_SET); // Go back to the start of the file
-
-        input = malloc(len + 1); // Allocate memory for the input
-        if (!input) {
-                perror("Failed to allocate memory");
-                fclose(file);
-                return 1; // Exit if memory allocation fails
-        }
-
-        read = fread(input, 1, len, file); // Read the file into the buffer
-        input[read] = '\0'; // Null-terminate the string
-
-        fclose(file); // Close the file
-        lexer_main(input); // run operations on text with buffer
-        free(input); // Free allocated memory
-
-        return 0;
-}
\ No newline at end of file
+// here is my parser it is a recursive descent (top down / LL) parser that builds the AST described in Parser Info
+// every parse_ function handles one rule of the grammar and the operator precedence is handled by precedence climbing
+// in parse_binary so we dont need a function for every level of precedence
+
+#include "Parser.h"
+
+// returned by peek once we run out of tokens so the parser never reads past the array
+static const Token endToken = { .type = UNKNOWN, .lexeme = "end of file" };
+
+// simple initialization of the arena no blocks until the first allocation
+void arena_init(Arena *arena) {
+        arena->head = NULL;
+}
+
+void *arena_alloc(Arena *arena, size_t size) {
+        size = (size + 15) & ~(size_t)15; // keep everything 16 byte aligned
+        ArenaBlock *block = arena->head;
+        if (!block || block->used + size > block->cap) {
+                size_t cap = size > ARENA_BLOCK_LEN ? size : ARENA_BLOCK_LEN;
+                block = malloc(sizeof(ArenaBlock) + cap);
+                if (!block) {
+                        fprintf(stderr, "SYNTAX ERROR: Unable to allocate AST memory\n");
+                        exit(1);
+                }
+                block->next = arena->head;
+                block->used = 0;
+                block->cap = cap;
+                arena->head = block;
+        }
+        void *memory = block->data + block->used;
+        block->used += size;
+        memset(memory, 0, size);
+        return memory;
+}
+
+char *arena_strdup(Arena *arena, const char *text) {
+        size_t len = strlen(text);
+        char *copy = arena_alloc(arena, len + 1);
+        memcpy(copy, text, len + 1);
+        return copy;
+}
+
+// moves every block of other into arena without copying anything the nodes stay where they are
+// they go in behind the block arena is allocating from so that block keeps filling up
+void arena_splice(Arena *arena, Arena *other) {
+        ArenaBlock *last = other->head;
+        if (!last) return;
+        while (last->next) last = last->next;
+        if (arena->head) {
+                last->next = arena->head->next;
+                arena->head->next = other->head;
+        } else arena->head = other->head;
+        other->head = NULL;
+}
+
+void arena_free(Arena *arena) {
+        ArenaBlock *block = arena->head;
+        while (block) {
+                ArenaBlock *next = block->next;
+                free(block);
+                block = next;
+        }
+        arena->head = NULL;
+}
+
+// comments never mean anything to the parser so we just step over them whenever we move (the drivers lex with them
+// stripped anyway but lexer_main still hands them out)
+static void skip_comments(Parser *parser) {
+        while (parser->pos < parser->count && (parser->tokens[parser->pos].type == SLCOMMENT || parser->tokens[parser->pos].type == MLCOMMENT)) parser->pos++;
+}
+
+void parser_init(Parser *parser, Token *tokens, size_t count, Arena *arena) {
+        parser_init_range(parser, tokens, 0, count, arena);
+}
+
+void parser_init_range(Parser *parser, Token *tokens, size_t start, size_t end, Arena *arena) {
+        parser->tokens = tokens;
+        parser->count = end;
+        parser->pos = start;
+        parser->arena = arena;
+        parser->diags = NULL;
+        parser->diagCount = 0;
+        parser->diagCap = 0;
+        parser->panic = 0;
+        skip_comments(parser);
+}
+
+void parser_free(Parser *parser) {
+        free(parser->diags);
+        parser->diags = NULL;
+        parser->diagCount = parser->diagCap = 0;
+}
+
+static const Token *peek(Parser *parser) {
+        return parser->pos < parser->count ? &parser->tokens[parser->pos] : &endToken;
+}
+
+// the token right before the current one skipping comments used for the same line checks
+static const Token *previous(Parser *parser) {
+        size_t i = parser->pos;
+        while (i > 0) {
+                i--;
+                if (parser->tokens[i].type != SLCOMMENT && parser->tokens[i].type != MLCOMMENT) return &parser->tokens[i];
+        }
+        return &endToken;
+}
+
+static int at_end(Parser *parser) {
+        return parser->pos >= parser->count;
+}
+
+static int check(Parser *parser, Type type) {
+        return !at_end(parser) && parser->tokens[parser->pos].type == type;
+}
+
+static const Token *advance(Parser *parser) {
+        const Token *token = peek(parser);
+        if (!at_end(parser)) {
+                parser->pos++;
+                skip_comments(parser);
+        }
+        return token;
+}
+
+static int match(Parser *parser, Type type) {
+        if (!check(parser, type)) return 0;
+        advance(parser);
+        return 1;
+}
+
+// true when the current token starts on the same line as the token before it
+// semicolons are optional so this is how x = 2.5 followed by (y) on the next line stays two statements
+static int same_line(Parser *parser) {
+        return !at_end(parser) && previous(parser)->line == peek(parser)->line;
+}
+
+// records an error at the current token only the first error in a statement is kept the rest are usually caused by the first one
+static void error(Parser *parser, const char *message) {
+        if (parser->panic) return;
+        parser->panic = 1;
+
+        if (parser->diagCount >= parser->diagCap) {
+                size_t newCap = parser->diagCap ? parser->diagCap * 2 : 8;
+                Diagnostic *newDiags = realloc(parser->diags, sizeof(Diagnostic) * newCap);
+                if (!newDiags) {
+                        perror("Error reallocating diagnostics");
+                        return;
+                }
+                parser->diags = newDiags;
+                parser->diagCap = newCap;
+        }
+        const Token *token = peek(parser);
+        if (at_end(parser) && parser->count > 0) token = &parser->tokens[parser->count - 1];
+
+        Diagnostic *diag = &parser->diags[parser->diagCount++];
+        diag->token = parser->pos;
+        diag->line = token->line;
+        diag->col = token->col;
+        snprintf(diag->message, DIAGNOSTIC_LEN, "%s : found '%.64s'", message, peek(parser)->lexeme);
+}
+
+static const Token *expect(Parser *parser, Type type, const char *message) {
+        if (check(parser, type)) return advance(parser);
+        error(parser, message);
+        return NULL;
+}
+
+static Node *new_node(Parser *parser, NodeType type, size_t token) {
+        Node *node = arena_alloc(parser->arena, sizeof(Node));
+        node->type = type;
+        node->token = token;
+        // a node made at the end of the input points at the last token
+        const Token *at = token < parser->count ? &parser->tokens[token] : parser->count ? &parser->tokens[parser->count - 1] : NULL;
+        node->line = at ? at->line : 0;
+        node->col = at ? at->col : 0;
+        return node;
+}
+
+// after an error skip ahead to something that looks like the start of the next statement
+static void synchronize(Parser *parser) {
+        size_t start = parser->pos;
+        while (!at_end(parser)) {
+                if (parser->pos != start) {
+                        switch (peek(parser)->type) {
+                                case IF: case WHILE: case FOR: case DO: case RETURN: case LET: case VAR: case CONST:
+                                case DEFINE: case CLASS: case IMPORT: case EXPORT: case BREAK: case CONTINUE: case OPENC: case CLOSEC:
+                                        parser->panic = 0;
+                                        return;
+                                default: break;
+                        }
+                        if (!same_line(parser)) break;
+                }
+                if (match(parser, SEMI)) break;
+                advance(parser);
+        }
+        parser->panic = 0;
+}
+
+static Node *parse_expression(Parser *parser);
+static Node *parse_block(Parser *parser);
+
+// removes the quotes and the escapes the string DFA allows (\" and \\)
+static char *unescape(Parser *parser, const char *lexeme) {
+        size_t len = strlen(lexeme);
+        char *text = arena_alloc(parser->arena, len + 1);
+        size_t out = 0;
+        size_t end = (len >= 2 && lexeme[len - 1] == '"') ? len - 1 : len; // an unterminated string has no closing quote
+        for (size_t i = 1; i < end; i++) {
+                if (lexeme[i] == '\\' && i + 1 < end) i++;
+                text[out++] = lexeme[i];
+        }
+        text[out] = '\0';
+        return text;
+}
+
+static Node *parse_primary(Parser *parser) {
+        size_t start = parser->pos;
+        const Token *token = peek(parser);
+        Node *node;
+
+        switch (token->type) {
+                case INT:
+                        node = new_node(parser, NODE_INT, start);
+                        node->ival = strtoll(token->lexeme, NULL, 10);
+                        advance(parser);
+                        return node;
+                case DOUBLE:
+                        node = new_node(parser, NODE_DOUBLE, start);
+                        node->dval = strtod(token->lexeme, NULL);
+                        advance(parser);
+                        return node;
+                case STRING:
+                        node = new_node(parser, NODE_STRING, start);
+                        node->text = unescape(parser, token->lexeme);
+                        advance(parser);
+                        return node;
+                case IDENTIFIER:
+                        node = new_node(parser, NODE_IDENTIFIER, start);
+                        node->name = arena_strdup(parser->arena, token->lexeme);
+                        advance(parser);
+                        return node;
+                case THIS:
+                        advance(parser);
+                        return new_node(parser, NODE_THIS, start);
+                case OPENP:
+                        advance(parser);
+                        node = parse_expression(parser);
+                        expect(parser, CLOSEP, "Expected ')' after expression");
+                        return node;
+                default:
+                        error(parser, "Expected an expression");
+                        return NULL;
+        }
+}
+
+static int is_target(const Node *node) {
+        return node && (node->type == NODE_IDENTIFIER || node->type == NODE_MEMBER);
+}
+
+// calls, member access and postfix ++ -- these have to be on the same line as what they apply to
+static Node *parse_postfix(Parser *parser) {
+        Node *node = parse_primary(parser);
+        while (node && !at_end(parser)) {
+                size_t start = parser->pos;
+                if (check(parser, OPENP) && same_line(parser)) {
+                        advance(parser);
+                        Node *call = new_node(parser, NODE_CALL, node->token);
+                        call->left = node;
+                        Node **tail = &call->right;
+                        if (!check(parser, CLOSEP)) {
+                                do {
+                                        *tail = parse_expression(parser);
+                                        if (!*tail) return NULL;
+                                        tail = &(*tail)->next;
+                                } while (match(parser, COMMA));
+                        }
+                        expect(parser, CLOSEP, "Expected ')' after arguments");
+                        node = call;
+                } else if (match(parser, DOT)) {
+                        const Token *name = expect(parser, IDENTIFIER, "Expected a property name after '.'");
+                        if (!name) return NULL;
+                        Node *member = new_node(parser, NODE_MEMBER, node->token);
+                        member->left = node;
+                        member->name = arena_strdup(parser->arena, name->lexeme);
+                        node = member;
+                } else if ((check(parser, INCREMENT) || check(parser, DECREMENT)) && same_line(parser)) {
+                        if (!is_target(node)) {
+                                error(parser, "Invalid target for postfix operator");
+                                return NULL;
+                        }
+                        Node *incdec = new_node(parser, NODE_INCDEC, start);
+                        incdec->op = advance(parser)->type;
+                        incdec->left = node;
+                        incdec->flags = NODE_POSTFIX;
+                        node = incdec;
+                } else {
+                        break;
+                }
+        }
+        return node;
+}
+
+static Node *parse_unary(Parser *parser) {
+        size_t start = parser->pos;
+        Type type = peek(parser)->type;
+
+        if (type == MINUS || type == NEGATION) {
+                advance(parser);
+                Node *node = new_node(parser, NODE_UNARY, start);
+                node->op = type;
+                node->left = parse_unary(parser);
+                return node->left ? node : NULL;
+        }
+        if (type == DOUBLENEGATION) { // !!x is just two nots the lexer glues them together
+                advance(parser);
+                Node *inner = new_node(parser, NODE_UNARY, start);
+                inner->op = NEGATION;
+                inner->left = parse_unary(parser);
+                if (!inner->left) return NULL;
+                Node *node = new_node(parser, NODE_UNARY, start);
+                node->op = NEGATION;
+                node->left = inner;
+                return node;
+        }
+        if (type == INCREMENT || type == DECREMENT) {
+                advance(parser);
+                Node *node = new_node(parser, NODE_INCDEC, start);
+                node->op = type;
+                node->left = parse_unary(parser);
+                if (!is_target(node->left)) {
+                        error(parser, "Invalid target for prefix operator");
+                        return NULL;
+                }
+                return node;
+        }
+        return parse_postfix(parser);
+}
+
+// binding power of every binary operator 0 means its not a binary operator
+static int precedence(Type type) {
+        switch (type) {
+                case OR: return 1;
+                case AND: return 2;
+                case BOR: return 3;
+                case BXOR: return 4;
+                case BAND: return 5;
+                case EQUALITY: case NOTEQUALS: return 6;
+                case LESS: case GREATER: case LESSEQUALS: case GREATEREQUALS: return 7;
+                case BSLEFT: case BSRIGHT: return 8;
+                case PLUS: case MINUS: return 9;
+                case TIMES: case DIVIDE: case MOD: return 10;
+                case POWER: return 11;
+                default: return 0;
+        }
+}
+
+// precedence climbing keeps folding operators into the left side while they bind at least as tight as minPrec
+static Node *parse_binary(Parser *parser, int minPrec) {
+        Node *left = parse_unary(parser);
+        while (left) {
+                Type type = peek(parser)->type;
+                int prec = at_end(parser) ? 0 : precedence(type);
+                if (prec == 0 || prec < minPrec) break;
+
+                size_t start = parser->pos;
+                advance(parser);
+                // ** is right associative so its right side is parsed at the same level everything else goes one higher
+                Node *right = parse_binary(parser, type == POWER ? prec : prec + 1);
+                if (!right) return NULL;
+
+                Node *node = new_node(parser, (type == OR || type == AND) ? NODE_LOGICAL : NODE_BINARY, start);
+                node->op = type;
+                node->left = left;
+                node->right = right;
+                left = node;
+        }
+        return left;
+}
+
+static int is_assignment(Type type) {
+        switch (type) {
+                case EQUAL: case PLUSEQUALS: case MINUSEQUALS: case TIMESEQUALS: case DIVIDEEQUALS: case MODEQUALS:
+                case OREQUALS: case ANDEQUALS: case XOREQUALS:
+                        return 1;
+                default:
+                        return 0;
+        }
+}
+
+static Node *parse_expression(Parser *parser) {
+        Node *left = parse_binary(parser, 1);
+        if (!left || at_end(parser) || !is_assignment(peek(parser)->type)) return left;
+
+        size_t start = parser->pos;
+        if (!is_target(left)) {
+                error(parser, "Invalid assignment target");
+                return NULL;
+        }
+        Node *node = new_node(parser, NODE_ASSIGN, start);
+        node->op = advance(parser)->type;
+        node->left = left;
+        node->right = parse_expression(parser); // assignment is right associative a = b = c
+        return node->right ? node : NULL;
+}
+
+// let x = 1 / var x / const x = 1
+static Node *parse_let(Parser *parser) {
+        size_t start = parser->pos;
+        Type kind = advance(parser)->type;
+        const Token *name = expect(parser, IDENTIFIER, "Expected a variable name");
+        if (!name) return NULL;
+
+        Node *node = new_node(parser, NODE_LET, start);
+        node->name = arena_strdup(parser->arena, name->lexeme);
+        if (kind == CONST) node->flags |= NODE_CONST;
+        if (match(parser, EQUAL)) {
+                node->right = parse_expression(parser);
+                if (!node->right) return NULL;
+        } else if (kind == CONST) {
+                error(parser, "Expected '=' after const declaration");
+                return NULL;
+        }
+        return node;
+}
+
+// ( condition ) used by if while and do
+static Node *parse_condition(Parser *parser, const char *what) {
+        char message[64];
+        snprintf(message, sizeof(message), "Expected '(' after %s", what);
+        if (!expect(parser, OPENP, message)) return NULL;
+        Node *cond = parse_expression(parser);
+        if (!cond) return NULL;
+        if (!expect(parser, CLOSEP, "Expected ')' after condition")) return NULL;
+        return cond;
+}
+
+// define name(a, b) { ... }
+static Node *parse_function(Parser *parser) {
+        size_t start = parser->pos;
+        advance(parser); // define
+        const Token *name = expect(parser, IDENTIFIER, "Expected a function name");
+        if (!name) return NULL;
+
+        Node *node = new_node(parser, NODE_FUNCTION, start);
+        node->name = arena_strdup(parser->arena, name->lexeme);
+        if (!expect(parser, OPENP, "Expected '(' after function name")) return NULL;
+        Node **tail = &node->left;
+        if (!check(parser, CLOSEP)) {
+                do {
+                        size_t paramStart = parser->pos;
+                        const Token *param = expect(parser, IDENTIFIER, "Expected a parameter name");
+                        if (!param) return NULL;
+                        *tail = new_node(parser, NODE_IDENTIFIER, paramStart);
+                        (*tail)->name = arena_strdup(parser->arena, param->lexeme);
+                        tail = &(*tail)->next;
+                } while (match(parser, COMMA));
+        }
+        if (!expect(parser, CLOSEP, "Expected ')' after parameters")) return NULL;
+        if (!check(parser, OPENC)) {
+                error(parser, "Expected '{' before function body");
+                return NULL;
+        }
+        node->body = parse_block(parser);
+        return node->body ? node : NULL;
+}
+
+// class Name extends Parent { let field = value  define method() { ... } }
+static Node *parse_class(Parser *parser) {
+        size_t start = parser->pos;
+        advance(parser); // class
+        const Token *name = expect(parser, IDENTIFIER, "Expected a class name");
+        if (!name) return NULL;
+
+        Node *node = new_node(parser, NODE_CLASS, start);
+        node->name = arena_strdup(parser->arena, name->lexeme);
+        if (match(parser, EXTENDS)) {
+                size_t parentStart = parser->pos;
+                const Token *parent = expect(parser, IDENTIFIER, "Expected a parent class name after extends");
+                if (!parent) return NULL;
+                node->left = new_node(parser, NODE_IDENTIFIER, parentStart);
+                node->left->name = arena_strdup(parser->arena, parent->lexeme);
+        }
+        if (!expect(parser, OPENC, "Expected '{' before class body")) return NULL;
+
+        Node **tail = &node->body;
+        while (!at_end(parser) && !check(parser, CLOSEC)) {
+                // access modifiers are accepted but everything is public for now
+                while (check(parser, PUBLIC) || check(parser, PRIVATE) || check(parser, PROTECTED) || check(parser, STATIC) || check(parser, FINAL)) advance(parser);
+
+                Node *member = NULL;
+                if (check(parser, LET) || check(parser, VAR) || check(parser, CONST)) member = parse_let(parser);
+                else if (check(parser, DEFINE)) member = parse_function(parser);
+                else error(parser, "Expected a field or method in class body");
+
+                if (!member) return NULL;
+                *tail = member;
+                tail = &member->next;
+                while (match(parser, SEMI));
+        }
+        if (!expect(parser, CLOSEC, "Expected '}' after class body")) return NULL;
+        return node;
+}
+
+// { statement* }
+static Node *parse_block(Parser *parser) {
+        size_t start = parser->pos;
+        advance(parser); // {
+        Node *block = new_node(parser, NODE_BLOCK, start);
+        Node **tail = &block->body;
+
+        while (!at_end(parser) && !check(parser, CLOSEC)) {
+                Node *statement = parse_statement(parser);
+                if (statement) {
+                        *tail = statement;
+                        tail = &statement->next;
+                } else if (parser->panic) {
+                        synchronize(parser);
+                }
+        }
+        if (!expect(parser, CLOSEC, "Expected '}' after block")) return NULL;
+        return block;
+}
+
+// the body of an if while do or for, a lone ; there is an empty block so the statement around it is not dropped
+static Node *parse_body(Parser *parser) {
+        if (!check(parser, SEMI)) return parse_statement(parser);
+        Node *block = new_node(parser, NODE_BLOCK, parser->pos);
+        advance(parser);
+        return block;
+}
+
+Node *parse_statement(Parser *parser) {
+        size_t start = parser->pos;
+        Node *node = NULL;
+
+        switch (peek(parser)->type) {
+                case SEMI: // empty statement
+                        advance(parser);
+                        return NULL;
+                case OPENC:
+                        return parse_block(parser);
+                case LET: case VAR: case CONST:
+                        node = parse_let(parser);
+                        break;
+                case IF:
+                        advance(parser);
+                        node = new_node(parser, NODE_IF, start);
+                        if (!(node->cond = parse_condition(parser, "if"))) return NULL;
+                        if (!(node->body = parse_body(parser))) return NULL;
+                        if (match(parser, ELSE) && !(node->orelse = parse_body(parser))) return NULL;
+                        return node;
+                case WHILE:
+                        advance(parser);
+                        node = new_node(parser, NODE_WHILE, start);
+                        if (!(node->cond = parse_condition(parser, "while"))) return NULL;
+                        if (!(node->body = parse_body(parser))) return NULL;
+                        return node;
+                case DO:
+                        advance(parser);
+                        node = new_node(parser, NODE_DO, start);
+                        if (!(node->body = parse_body(parser))) return NULL;
+                        if (!expect(parser, WHILE, "Expected 'while' after do body")) return NULL;
+                        if (!(node->cond = parse_condition(parser, "while"))) return NULL;
+                        break;
+                case FOR:
+                        advance(parser);
+                        node = new_node(parser, NODE_FOR, start);
+                        if (!expect(parser, OPENP, "Expected '(' after for")) return NULL;
+                        if (check(parser, LET) || check(parser, VAR) || check(parser, CONST)) node->init = parse_let(parser);
+                        else if (!check(parser, SEMI)) node->init = parse_expression(parser);
+                        if (parser->panic || !expect(parser, SEMI, "Expected ';' after for initializer")) return NULL;
+                        if (!check(parser, SEMI) && !(node->cond = parse_expression(parser))) return NULL;
+                        if (!expect(parser, SEMI, "Expected ';' after for condition")) return NULL;
+                        if (!check(parser, CLOSEP) && !(node->step = parse_expression(parser))) return NULL;
+                        if (!expect(parser, CLOSEP, "Expected ')' after for clauses")) return NULL;
+                        if (!(node->body = parse_body(parser))) return NULL;
+                        return node;
+                case BREAK:
+                        advance(parser);
+                        node = new_node(parser, NODE_BREAK, start);
+                        break;
+                case CONTINUE:
+                        advance(parser);
+                        node = new_node(parser, NODE_CONTINUE, start);
+                        break;
+                case RETURN:
+                        advance(parser);
+                        node = new_node(parser, NODE_RETURN, start);
+                        // return with nothing after it on the line returns nothing
+                        if (same_line(parser) && !check(parser, SEMI) && !check(parser, CLOSEC)) {
+                                if (!(node->right = parse_expression(parser))) return NULL;
+                        }
+                        break;
+                case DEFINE:
+                        return parse_function(parser);
+                case CLASS:
+                        return parse_class(parser);
+                case IMPORT:
+                        // import "path" the build (Build.c) finds the module the parser only keeps the path
+                        advance(parser);
+                        if (!check(parser, STRING)) {
+                                error(parser, "Expected a module path after import");
+                                return NULL;
+                        }
+                        node = new_node(parser, NODE_IMPORT, start);
+                        node->text = unescape(parser, advance(parser)->lexeme);
+                        break;
+                case EXPORT:
+                        advance(parser);
+                        if (check(parser, DEFINE)) node = parse_function(parser);
+                        else if (check(parser, CLASS)) node = parse_class(parser);
+                        else {
+                                error(parser, "Only functions and classes can be exported");
+                                return NULL;
+                        }
+                        if (node) node->flags |= NODE_EXPORT;
+                        return node;
+                default:
+                        node = new_node(parser, NODE_EXPRESSION, start);
+                        if (!(node->left = parse_expression(parser))) return NULL;
+                        break;
+        }
+        if (!node) return NULL;
+        match(parser, SEMI); // semicolons are optional
+        return node;
+}
+
+void parse_top_level(Parser *parser, Node ***tail) {
+        Node *statement = parse_statement(parser);
+        if (statement) {
+                **tail = statement;
+                *tail = &statement->next;
+        } else if (parser->panic) {
+                synchronize(parser);
+        } else if (check(parser, CLOSEC)) {
+                // a } with no matching { would otherwise stop the loop from moving
+                error(parser, "Unexpected '}'");
+                synchronize(parser);
+                advance(parser);
+        }
+}
+
+Node *new_program(Parser *parser) {
+        return new_node(parser, NODE_PROGRAM, 0);
+}
+
+Node *parse_program(Parser *parser) {
+        Node *program = new_program(parser);
+        Node **tail = &program->body;
+
+        while (!at_end(parser)) parse_top_level(parser, &tail);
+        return program;
+}
+
+size_t print_diagnostics(const Diagnostic *diags, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+                fprintf(error_stream(), "SYNTAX ERROR: %s \nLINE : %lu, COL : %lu\n", diags[i].message, diags[i].line, diags[i].col);
+        }
+        return count;
+}
+
+static const char *node_name(NodeType type) {
+        static const char *names[] = {
+                "PROGRAM", "BLOCK", "LET", "IF", "WHILE", "DO", "FOR", "BREAK", "CONTINUE", "RETURN",
+                "FUNCTION", "CLASS", "EXPRESSION", "IMPORT",
+                "INT", "DOUBLE", "STRING", "IDENTIFIER", "THIS", "BINARY", "LOGICAL", "UNARY",
+                "ASSIGN", "INCDEC", "CALL", "MEMBER",
+        };
+        return names[type];
+}
+
+// prints a labelled child list one level deeper
+static void print_list(FILE *out, const char *label, const Node *node, int depth) {
+        if (!node) return;
+        fprintf(out, "%*s%s:\n", depth * 2, "", label);
+        for (; node; node = node->next) print_ast(out, node, depth + 1);
+}
+
+void print_ast(FILE *out, const Node *node, int depth) {
+        if (!node) return;
+        fprintf(out, "%*s%s", depth * 2, "", node_name(node->type));
+        switch (node->type) {
+                case NODE_INT: fprintf(out, " %lld", node->ival); break;
+                case NODE_DOUBLE: fprintf(out, " %g", node->dval); break;
+                case NODE_STRING: case NODE_IMPORT: fprintf(out, " \"%s\"", node->text); break;
+                case NODE_BINARY: case NODE_LOGICAL: case NODE_UNARY: case NODE_ASSIGN: case NODE_INCDEC:
+                        fprintf(out, " op %d%s", node->op, (node->flags & NODE_POSTFIX) ? " postfix" : "");
+                        break;
+                default: break;
+        }
+        if (node->name) fprintf(out, " %s", node->name);
+        if (node->flags & NODE_CONST) fprintf(out, " const");
+        if (node->flags & NODE_EXPORT) fprintf(out, " export");
+        fprintf(out, " @%zu\n", node->token);
+
+        // statement lists and argument lists hang off left right and body as linked lists
+        int leftIsList = node->type == NODE_FUNCTION;
+        int rightIsList = node->type == NODE_CALL;
+        int bodyIsList = node->type == NODE_PROGRAM || node->type == NODE_BLOCK || node->type == NODE_CLASS;
+
+        if (leftIsList) print_list(out, "params", node->left, depth + 1);
+        else print_ast(out, node->left, depth + 1);
+        print_ast(out, node->init, depth + 1);
+        print_ast(out, node->cond, depth + 1);
+        print_ast(out, node->step, depth + 1);
+        if (rightIsList) print_list(out, "args", node->right, depth + 1);
+        else print_ast(out, node->right, depth + 1);
+        if (bodyIsList) for (const Node *child = node->body; child; child = child->next) print_ast(out, child, depth + 1);
+        else print_ast(out, node->body, depth + 1);
+        if (node->orelse) print_list(out, "else", node->orelse, depth + 1);
+}
@@ -0,0 +1,108 @@
+// this is the header for the parser it turns the token stream from the DFA lexer into an AST (see Parser Info)
+// I ended up going with a top down (recursive descent) parser for now because the vm needed something to run
+// and it is a lot easier to get right than the LR(1) table I was planning, the AST it builds is what an LR parser would build anyway
+
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "DFA_Lexer.h" // token types and the lexer
+
+#define ARENA_BLOCK_LEN 65536 // size of each block of AST memory
+#define DIAGNOSTIC_LEN 256 // maximum length of a single error message
+
+// every kind of node in the tree statements first and then expressions
+typedef enum {
+        NODE_PROGRAM, NODE_BLOCK, NODE_LET, NODE_IF, NODE_WHILE, NODE_DO, NODE_FOR, NODE_BREAK, NODE_CONTINUE, NODE_RETURN,
+        NODE_FUNCTION, NODE_CLASS, NODE_EXPRESSION, NODE_IMPORT,
+        NODE_INT, NODE_DOUBLE, NODE_STRING, NODE_IDENTIFIER, NODE_THIS, NODE_BINARY, NODE_LOGICAL, NODE_UNARY,
+        NODE_ASSIGN, NODE_INCDEC, NODE_CALL, NODE_MEMBER,
+} NodeType;
+
+// one node of the tree not every node uses every field the comment says who uses what
+typedef struct Node {
+        NodeType type;
+        Type op; // operator token for binary logical unary assign and incdec nodes
+        size_t token; // index of the token the node starts at so errors can point back at the source
+        size_t line; // line and col of that token copied in so the tree can be compiled without the tokens
+        size_t col;
+        struct Node *left; // left operand, assignment target, callee, member object, function parameters, class parent
+        struct Node *right; // right operand, assigned value, call arguments, let initializer, return value
+        struct Node *cond; // condition for if while do and for
+        struct Node *body; // body of loops functions and classes or the statements in a block / program
+        struct Node *orelse; // else branch of an if
+        struct Node *init; // for loop initializer
+        struct Node *step; // for loop step
+        struct Node *next; // next node in a list (statements, arguments, parameters, class members)
+        char *name; // identifier text for identifiers let function class and member nodes
+        char *text; // unescaped contents of a string literal or the path of an import
+        long long ival; // value of an int literal
+        double dval; // value of a double literal
+        int flags; // NODE_POSTFIX for x++, NODE_CONST for const declarations and NODE_EXPORT for exported functions and classes
+} Node;
+
+#define NODE_POSTFIX 1 // x++ instead of ++x
+#define NODE_CONST 2 // declared with const
+#define NODE_EXPORT 4 // export define / export class
+
+// nodes are bump allocated out of big blocks so a whole tree is freed at once instead of node by node
+typedef struct ArenaBlock {
+        struct ArenaBlock *next;
+        size_t used;
+        size_t cap;
+        char data[];
+} ArenaBlock;
+
+typedef struct {
+        ArenaBlock *head; // block we are currently allocating from
+} Arena;
+
+// errors are collected instead of printed straight away so the driver decides when to print them
+typedef struct {
+        size_t token; // token index the error was reported at
+        size_t line;
+        size_t col;
+        char message[DIAGNOSTIC_LEN];
+} Diagnostic;
+
+typedef struct {
+        Token *tokens; // token stream from lexer_main
+        size_t count; // number of tokens
+        size_t pos; // index of the current token
+        Arena *arena; // where the nodes go
+        Diagnostic *diags; // collected syntax errors
+        size_t diagCount;
+        size_t diagCap;
+        int panic; // set after an error so we only report one error per statement
+} Parser;
+
+// simple initialization of the arena
+void arena_init(Arena *arena);
+// grabs size bytes of zeroed memory from the arena
+void *arena_alloc(Arena *arena, size_t size);
+// copies a string into the arena
+char *arena_strdup(Arena *arena, const char *text);
+// moves the blocks of other into arena (other is left empty)
+void arena_splice(Arena *arena, Arena *other);
+// frees every block of the arena
+void arena_free(Arena *arena);
+
+// sets the parser up to read tokens[0 .. count)
+void parser_init(Parser *parser, Token *tokens, size_t count, Arena *arena);
+// sets the parser up to read tokens[start .. end) the tokens before start are still looked at for the same line checks
+void parser_init_range(Parser *parser, Token *tokens, size_t start, size_t end, Arena *arena);
+// frees the diagnostics the arena is owned by the caller
+void parser_free(Parser *parser);
+// the empty NODE_PROGRAM every parse starts from placed at the first token so the sequential parallel and pipelined trees match
+Node *new_program(Parser *parser);
+// parses the whole token stream into a NODE_PROGRAM
+Node *parse_program(Parser *parser);
+// parses one top level statement (recovering from errors) and links it onto the list *tail points into
+void parse_top_level(Parser *parser, Node ***tail);
+// parses a single statement starting at the current token
+Node *parse_statement(Parser *parser);
+// prints the diagnostics to stderr and returns how many there were
+size_t print_diagnostics(const Diagnostic *diags, size_t count);
+// prints the tree in an indented text form used by --ast
+void print_ast(FILE *out, const Node *node, int depth);
+
+#endif
@@ -0,0 +1,307 @@
+// here is the pipelined front end (see Pipeline.h) the reader and the lexer run on their own threads and the parser on the
+// thread that called pipeline_parse, everything between them goes through the two rings below
+
+#include <stdatomic.h> // the ring counters
+#include <pthread.h> // reader and lexer threads
+#include <sched.h> // sched_yield while a ring is full or empty
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h> // clock_gettime for the latency numbers and nanosleep
+#include "Parallel_Parser.h" // decl_scan
+#include "Pipeline.h"
+
+// a single producer single consumer ring of PIPELINE_SLOTS fixed size slots, the producer fills the slot at tail and then
+// moves tail, the consumer reads the slot at head and then moves head, each counter only ever has one thread writing it
+typedef struct {
+        _Atomic size_t head; // slots the consumer is done with
+        char padHead[64 - sizeof(size_t)]; // head and tail on their own cache lines so the two threads do not fight over one
+        _Atomic size_t tail; // slots the producer filled
+        char padTail[64 - sizeof(size_t)];
+        char *slots;
+        size_t slotSize;
+} Ring;
+
+// a piece of the file on its way from the reader to the lexer
+typedef struct {
+        size_t length;
+        int last; // end of the file or reading failed
+        int error; // errno when reading failed
+        char data[PIPELINE_CHUNK];
+} Chunk;
+
+// tokens on their way from the lexer to the parser
+typedef struct {
+        size_t count;
+        int last; // no tokens after these
+        Token tokens[PIPELINE_BATCH];
+} Batch;
+
+typedef struct {
+        const char *path;
+        TrieNode *keywords;
+        TriviaTable *trivia;
+        Ring chunks;
+        Ring batches;
+        size_t readerWaits;
+        size_t lexerWaits;
+        // set by the lexer before it hands over its last batch
+        char *source;
+        size_t length;
+        int error;
+} Stages;
+
+static double now_seconds(void) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static int ring_init(Ring *ring, size_t slotSize) {
+        atomic_init(&ring->head, 0);
+        atomic_init(&ring->tail, 0);
+        ring->slotSize = slotSize;
+        ring->slots = malloc(slotSize * PIPELINE_SLOTS);
+        return ring->slots != NULL;
+}
+
+// a short wait gives the core to the other stage, a long one (a slow disk or pipe) sleeps a little so nothing burns a core
+static void ring_pause(int *tries) {
+        if ((*tries)++ < 64) sched_yield();
+        else nanosleep(&(struct timespec){0, 50000}, NULL);
+}
+
+static void *ring_slot(Ring *ring, size_t index) {
+        return ring->slots + (index % PIPELINE_SLOTS) * ring->slotSize;
+}
+
+// the producer gets the next free slot, waiting while the consumer still has every slot (this is the backpressure)
+static void *ring_reserve(Ring *ring, size_t *waits) {
+        size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+        if (tail - atomic_load_explicit(&ring->head, memory_order_acquire) >= PIPELINE_SLOTS) {
+                int tries = 0;
+                (*waits)++;
+                while (tail - atomic_load_explicit(&ring->head, memory_order_acquire) >= PIPELINE_SLOTS) ring_pause(&tries);
+        }
+        return ring_slot(ring, tail);
+}
+
+// hands the reserved slot over, the release makes everything written into it visible before the new tail is
+static void ring_publish(Ring *ring) {
+        atomic_store_explicit(&ring->tail, atomic_load_explicit(&ring->tail, memory_order_relaxed) + 1, memory_order_release);
+}
+
+// the consumer waits for a filled slot
+static void *ring_next(Ring *ring) {
+        size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+        int tries = 0;
+        while (atomic_load_explicit(&ring->tail, memory_order_acquire) == head) ring_pause(&tries);
+        return ring_slot(ring, head);
+}
+
+// gives the slot from ring_next back to the producer
+static void ring_release(Ring *ring) {
+        atomic_store_explicit(&ring->head, atomic_load_explicit(&ring->head, memory_order_relaxed) + 1, memory_order_release);
+}
+
+static void *reader_stage(void *arg) {
+        Stages *stages = arg;
+        int fd = open(stages->path, O_RDONLY | O_CLOEXEC);
+        int error = fd < 0 ? errno : 0;
+#ifdef POSIX_FADV_SEQUENTIAL
+        if (fd >= 0) posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL); // asks the kernel to read ahead further
+#endif
+        int last = 0;
+        while (!last) {
+                Chunk *chunk = ring_reserve(&stages->chunks, &stages->readerWaits);
+                chunk->length = 0;
+                chunk->error = error;
+                if (!error) {
+                        ssize_t got;
+                        do got = read(fd, chunk->data, PIPELINE_CHUNK);
+                        while (got < 0 && errno == EINTR);
+                        if (got < 0) chunk->error = errno;
+                        else chunk->length = (size_t)got;
+                        last = got <= 0;
+                }
+                chunk->last = last = last || error;
+                ring_publish(&stages->chunks);
+        }
+        if (fd >= 0) close(fd);
+        return NULL;
+}
+
+// hands the batch to the parser and starts a new one
+static Batch *next_batch(Stages *stages, Batch *batch) {
+        ring_publish(&stages->batches);
+        batch = ring_reserve(&stages->batches, &stages->lexerWaits);
+        batch->count = 0;
+        batch->last = 0;
+        return batch;
+}
+
+static void *lexer_stage(void *arg) {
+        Stages *stages = arg;
+        size_t cap = PIPELINE_CHUNK + 1, length = 0;
+        char *source = malloc(cap);
+        Lexer lexer;
+        if (source) source[0] = '\0';
+        else stages->error = ENOMEM;
+        lexer_init(&lexer, source, stages->keywords);
+        lexer_strip(&lexer, stages->trivia);
+        lexer.more = 1;
+        Batch *batch = ring_reserve(&stages->batches, &stages->lexerWaits);
+        batch->count = 0;
+        batch->last = 0;
+
+        // every chunk gets taken even after an error so the reader never sits on a full ring
+        while (lexer.more) {
+                Chunk *chunk = ring_next(&stages->chunks);
+                if (chunk->last) lexer.more = 0;
+                if (chunk->error && !stages->error) stages->error = chunk->error;
+                if (!stages->error && length + chunk->length + 1 > cap) {
+                        while (length + chunk->length + 1 > cap) cap *= 2;
+                        char *grown = realloc(source, cap);
+                        if (grown) {
+                                // the lexer points into the buffer so it moves along with it
+                                lexer.current = grown + (lexer.current - lexer.input);
+                                lexer.input = source = grown;
+                        } else stages->error = ENOMEM;
+                }
+                if (!stages->error) {
+                        memcpy(source + length, chunk->data, chunk->length);
+                        length += chunk->length;
+                        source[length] = '\0';
+                }
+                ring_release(&stages->chunks);
+                if (stages->error) continue;
+
+                while (lexer_next(&lexer, &batch->tokens[batch->count]) == 1) {
+                        if (++batch->count == PIPELINE_BATCH) batch = next_batch(stages, batch);
+                }
+                // the tokens that are done go over now instead of waiting for the batch to fill up with the next chunk
+                if (batch->count > 0 && lexer.more) batch = next_batch(stages, batch);
+        }
+        stages->source = source;
+        stages->length = length;
+        batch->last = 1;
+        ring_publish(&stages->batches);
+        return NULL;
+}
+
+Node *pipeline_parse(const char *path, TrieNode *keywords, TriviaTable *trivia, Parser *parser, Arena *arena, Pipeline *out) {
+        memset(out, 0, sizeof(Pipeline));
+        double start = now_seconds();
+        Stages stages;
+        memset(&stages, 0, sizeof(Stages));
+        stages.path = path;
+        stages.keywords = keywords;
+        stages.trivia = trivia;
+        if (!ring_init(&stages.chunks, sizeof(Chunk)) || !ring_init(&stages.batches, sizeof(Batch))) {
+                free(stages.chunks.slots);
+                free(stages.batches.slots);
+                errno = ENOMEM;
+                return NULL;
+        }
+        // the lexer goes first so when the reader cannot start the lexer can still be told there is nothing coming
+        pthread_t lexThread, readThread;
+        int failed = pthread_create(&lexThread, NULL, lexer_stage, &stages);
+        if (failed) {
+                free(stages.chunks.slots);
+                free(stages.batches.slots);
+                errno = failed;
+                return NULL;
+        }
+        int reading = pthread_create(&readThread, NULL, reader_stage, &stages) == 0;
+        if (!reading) {
+                Chunk *chunk = ring_reserve(&stages.chunks, &stages.readerWaits);
+                chunk->length = 0;
+                chunk->last = 1;
+                chunk->error = EAGAIN;
+                ring_publish(&stages.chunks);
+        }
+
+        parser_init(parser, NULL, 0, arena);
+        // the program node is made once the first token is there so it sits on it like the one parse_program makes
+        Node *program = NULL;
+        Node **tail = NULL;
+        Token *tokens = NULL;
+        size_t count = 0, cap = 0;
+        DeclScan scan;
+        decl_scan_init(&scan);
+        int streaming = 1, last = 0, error = 0;
+        while (!last) {
+                Batch *batch = ring_next(&stages.batches);
+                if (!error && count + batch->count > cap) {
+                        size_t newCap = cap ? cap : TOKEN_STREAM_LEN;
+                        while (newCap < count + batch->count) newCap *= 2;
+                        Token *grown = realloc(tokens, sizeof(Token) * newCap);
+                        if (grown) {
+                                tokens = grown;
+                                cap = newCap;
+                        } else error = ENOMEM;
+                }
+                if (!error && batch->count > 0) {
+                        memcpy(tokens + count, batch->tokens, sizeof(Token) * batch->count);
+                        count += batch->count;
+                }
+                last = batch->last;
+                ring_release(&stages.batches);
+                if (error) continue;
+                if (count > 0 && out->firstToken == 0) out->firstToken = now_seconds() - start;
+
+                parser->tokens = tokens;
+                if (!program && count > 0) {
+                        parser->count = count;
+                        program = new_program(parser);
+                        tail = &program->body;
+                }
+                // every declaration that is known to be finished gets parsed right away with the parser stopped at its end
+                size_t next;
+                while (streaming && decl_scan(&scan, tokens, count, &next)) {
+                        size_t from = parser->pos, diags = parser->diagCount;
+                        Node **mark = tail;
+                        parser->count = next;
+                        while (parser->pos < next) parse_top_level(parser, &tail);
+                        if (parser->diagCount == diags && !parser->panic && parser->pos == next) {
+                                if (out->firstDeclaration == 0) out->firstDeclaration = now_seconds() - start;
+                                continue;
+                        }
+                        // error recovery can run past the end of the declaration so the rest waits for every token and gets
+                        // parsed from the start of this one just like parse_program would
+                        parser->pos = from;
+                        parser->diagCount = diags;
+                        parser->panic = 0;
+                        *mark = NULL;
+                        tail = mark;
+                        streaming = 0;
+                }
+        }
+        pthread_join(lexThread, NULL);
+        if (reading) pthread_join(readThread, NULL);
+        free(stages.chunks.slots);
+        free(stages.batches.slots);
+        out->source = stages.source;
+        out->length = stages.length;
+        out->readerWaits = stages.readerWaits;
+        out->lexerWaits = stages.lexerWaits;
+        if (!error) error = stages.error;
+        if (error) {
+                free(tokens);
+                free(out->source);
+                out->source = NULL;
+                parser_free(parser);
+                errno = error;
+                return NULL;
+        }
+
+        // the last declaration (it has no token after it) and everything after a syntax error
+        parser->tokens = tokens;
+        parser->count = count;
+        if (!program) {
+                program = new_program(parser);
+                tail = &program->body;
+        }
+        while (parser->pos < count) parse_top_level(parser, &tail);
+        return program;
+}
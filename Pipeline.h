@@ -0,0 +1,41 @@
+// this is the header for the pipelined front end, --pipeline reads lexes and parses a file with all three going at once
+// instead of reading the whole file then lexing all of it then parsing all of it
+//
+//   reader  its own thread reading the file PIPELINE_CHUNK bytes at a time (plain read() so fifos and pipes work too)
+//   lexer   its own thread appending the chunks to the source and lexing up to the last token it knows is finished
+//   parser  the calling thread, collects the tokens and parses every top level declaration as soon as the token after it
+//           shows it is finished (the same ends the parallel parser splits at, see Parallel_Parser.h)
+// the stages hand chunks and batches of tokens down through single producer single consumer ring buffers that never lock,
+// a stage that gets too far ahead waits for a free slot so only a few slots are ever in flight however big the file is
+//
+// the tokens tree and errors come out the same as lexer_run and parse_program, a declaration with a syntax error makes the
+// parser wait for the rest of the tokens and go on from its start like parse_program would
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include "Parser.h"
+
+#ifndef PIPELINE_CHUNK
+#define PIPELINE_CHUNK (64 * 1024) // bytes the reader reads at a time
+#endif
+#ifndef PIPELINE_BATCH
+#define PIPELINE_BATCH 64 // tokens the lexer hands over at a time (a token is a bit over 1KB)
+#endif
+#define PIPELINE_SLOTS 8 // chunks or batches in flight between two stages
+
+typedef struct {
+        char *source; // the whole file null terminated, the caller frees it
+        size_t length;
+        double firstToken; // seconds from the start until the parser had its first token
+        double firstDeclaration; // until the first declaration was parsed
+        size_t readerWaits; // times the reader found every slot full and had to wait for the lexer
+        size_t lexerWaits; // same for the lexer waiting on the parser
+} Pipeline;
+
+// reads lexes and parses path with trivia going into trivia when it is not NULL (comments are always stripped)
+// afterwards parser is set up on the whole token array (the caller frees parser->tokens) with the errors in its diagnostics
+// returns the program or NULL with errno set when the file could not be read
+Node *pipeline_parse(const char *path, TrieNode *keywords, TriviaTable *trivia, Parser *parser, Arena *arena, Pipeline *out);
+
+#endif
@@ -0,0 +1,390 @@
+// here is the compile server (see Server.h) a request is one message with a header the working directory and the arguments
+// separated by '\0' plus the stdin stdout and stderr of the client passed over the socket, the answer is the exit status
+// as a 4 byte int, output goes straight to the client's own stdout and stderr so nothing has to be copied through the socket
+
+#include <sys/socket.h> // unix sockets and passing file descriptors
+#include <sys/un.h>
+#include <sys/stat.h> // stat for the cache
+#include <sys/time.h> // timeval for the request timeout
+#include <sys/wait.h> // waiting on the child that runs the program
+#include <sys/syscall.h> // pidfd_open
+#include <poll.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h> // PATH_MAX for realpath
+#include <stdint.h>
+#include "Parallel_Parser.h"
+#include "Module.h" // module_hash and module_scan_imports
+#include "Server.h"
+
+static volatile sig_atomic_t stopping = 0; // set by SIGINT and SIGTERM
+
+static void on_signal(int signal) {
+        (void)signal;
+        stopping = 1;
+}
+
+static int read_all(int fd, void *data, size_t length) {
+        char *at = data;
+        while (length > 0) {
+                ssize_t got = read(fd, at, length);
+                if (got < 0 && errno == EINTR) continue;
+                if (got <= 0) return 0;
+                at += got;
+                length -= (size_t)got;
+        }
+        return 1;
+}
+
+static void write_all(int fd, const void *data, size_t length) {
+        const char *at = data;
+        while (length > 0) {
+                ssize_t wrote = write(fd, at, length);
+                if (wrote < 0 && errno == EINTR) continue;
+                if (wrote <= 0) return; // the client is gone nobody is left to tell
+                at += wrote;
+                length -= (size_t)wrote;
+        }
+}
+
+static void free_file(CachedFile *file) {
+        arena_free(&file->arena);
+        free(file->path);
+        free(file);
+}
+
+// takes out the files that cannot be found any more and the least recently used ones past the cap (except keep)
+static void trim_cache(Server *server, const CachedFile *keep) {
+        size_t kept = 0;
+        struct stat info;
+        CachedFile **link = &server->files;
+        while (*link) {
+                CachedFile *file = *link;
+                if (file != keep && (kept >= SERVER_MAX_FILES || stat(file->path, &info) != 0)) {
+                        *link = file->next;
+                        free_file(file);
+                        server->fileCount--;
+                        continue;
+                }
+                kept++;
+                link = &file->next;
+        }
+}
+
+CachedFile *server_source(Server *server, const char *path, int jobs) {
+        char resolved[PATH_MAX];
+        struct stat info;
+        if (!realpath(path, resolved) || stat(resolved, &info) != 0) {
+                perror("Could not open file");
+                return NULL;
+        }
+        long long mtime = (long long)info.st_mtim.tv_sec * 1000000000LL + info.st_mtim.tv_nsec, size = (long long)info.st_size;
+        CachedFile **link = &server->files;
+        while (*link && strcmp((*link)->path, resolved) != 0) link = &(*link)->next;
+        CachedFile *old = *link;
+        if (old) {
+                // moves to the front so the list stays in the order the files were last used
+                *link = old->next;
+                old->next = server->files;
+                server->files = old;
+                link = &server->files;
+        }
+        if (old && old->mtime == mtime && old->size == size) {
+                server->hits++;
+                return old;
+        }
+
+        size_t length = 0;
+        char *input = read_source(resolved, &length);
+        if (!input) {
+                perror("Could not open file");
+                return NULL;
+        }
+        unsigned long long hash = module_hash(input, length, MODULE_HASH_SEED);
+        if (old && old->hash == hash) {
+                // only touched
+                old->mtime = mtime;
+                old->size = size;
+                free(input);
+                server->hits++;
+                return old;
+        }
+
+        CachedFile *file = calloc(1, sizeof(CachedFile));
+        if (!file) {
+                fprintf(stderr, "SERVER ERROR: Out of memory\n");
+                free(input);
+                return NULL;
+        }
+        file->path = strdup(resolved);
+        file->mtime = mtime;
+        file->size = size;
+        file->hash = hash;
+        char **imports;
+        size_t importCount = module_scan_imports(input, &imports);
+        for (size_t i = 0; i < importCount; i++) free(imports[i]);
+        free(imports);
+        file->hasImports = importCount > 0;
+        size_t count = 0;
+        Token *tokens = lexer_run_stripped(input, &count, server->keywords, NULL);
+        free(input);
+        arena_init(&file->arena);
+
+        // the lexer prints its own errors so a file with an invalid token is never kept or they would not show up again
+        int ok = tokens != NULL;
+        for (size_t i = 0; ok && i < count; i++) ok = tokens[i].type != INVALID;
+        if (tokens) {
+                Parser parser;
+                parser_init(&parser, tokens, count, &file->arena);
+                file->program = jobs > 1 ? parse_program_parallel(&parser, jobs) : parse_program(&parser);
+                if (print_diagnostics(parser.diags, parser.diagCount)) ok = 0;
+                parser_free(&parser);
+        }
+        free(tokens); // the tree has everything the compiler needs
+        server->misses++;
+        // the old version is stale either way
+        if (old) {
+                *link = old->next;
+                free_file(old);
+                server->fileCount--;
+        }
+        if (!ok) {
+                free_file(file);
+                return NULL;
+        }
+        file->next = server->files;
+        server->files = file;
+        server->fileCount++;
+        // a file that had to be parsed already cost far more than a stat of every other one
+        trim_cache(server, file);
+        return file;
+}
+
+int server_fork(Server *server, int *status) {
+        if (!server) return 1;
+        fflush(stdout);
+        fflush(stderr);
+        pid_t child = fork();
+        if (child < 0) {
+                fprintf(stderr, "SERVER ERROR: Could not start the program\n");
+                *status = 1;
+                return 0;
+        }
+        if (child == 0) {
+                signal(SIGINT, SIG_DFL);
+                signal(SIGTERM, SIG_DFL);
+                signal(SIGPIPE, SIG_DFL);
+                close(server->listener);
+                return 1;
+        }
+
+        // wait for the child but kill it if the client hangs up (ctrl c on the client)
+        int result = 0;
+        int pidfd = -1;
+#ifdef SYS_pidfd_open
+        pidfd = (int)syscall(SYS_pidfd_open, child, 0);
+#endif
+        if (pidfd >= 0) {
+                struct pollfd watch[2] = {{pidfd, POLLIN, 0}, {server->client, POLLIN, 0}};
+                while (1) {
+                        int ready = poll(watch, 2, -1);
+                        if (ready < 0 && errno == EINTR && !stopping) continue;
+                        if (ready < 0 || (watch[1].revents && !watch[0].revents)) kill(child, SIGKILL);
+                        break;
+                }
+                close(pidfd);
+        }
+        while (waitpid(child, &result, 0) < 0 && errno == EINTR) {}
+        if (WIFSIGNALED(result)) {
+                fprintf(stderr, "RUNTIME ERROR: The program was killed by signal %d\n", WTERMSIG(result));
+                *status = 128 + WTERMSIG(result);
+        } else *status = WEXITSTATUS(result);
+        return 0;
+}
+
+void server_exit(Server *server, int status) {
+        if (!server) return;
+        fflush(stdout);
+        fflush(stderr);
+        _exit(status & 0xFF);
+}
+
+// takes the header and the three file descriptors of the client followed by the rest of the request
+static char *receive_request(int client, int fds[3], uint32_t *length) {
+        uint32_t header[2];
+        union {
+                char buffer[CMSG_SPACE(sizeof(int) * 3)];
+                struct cmsghdr align;
+        } control;
+        struct iovec io = {header, sizeof(header)};
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &io;
+        message.msg_iovlen = 1;
+        message.msg_control = control.buffer;
+        message.msg_controllen = sizeof(control.buffer);
+        ssize_t got = recvmsg(client, &message, MSG_CMSG_CLOEXEC);
+        if (got <= 0) return NULL;
+
+        int received = 0;
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+        if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                received = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+                if (received > 3) received = 3;
+                memcpy(fds, CMSG_DATA(cmsg), sizeof(int) * (size_t)received);
+        }
+        int ok = received == 3 && (got == sizeof(header) || read_all(client, (char *)header + got, sizeof(header) - (size_t)got));
+        ok = ok && header[0] == SERVER_MAGIC && header[1] <= SERVER_MAX_REQUEST;
+        char *payload = ok ? malloc((size_t)header[1] + 1) : NULL;
+        if (payload && read_all(client, payload, header[1])) {
+                payload[header[1]] = '\0';
+                *length = header[1];
+                return payload;
+        }
+        free(payload);
+        for (int i = 0; i < received; i++) close(fds[i]);
+        return NULL;
+}
+
+// runs one request with the client's working directory and stdio, returns 1 if the server should stop afterwards
+static int serve(Server *server, int client, ServerCommand command) {
+        int fds[3];
+        uint32_t length = 0;
+        char *payload = receive_request(client, fds, &length);
+        if (!payload) return 0;
+
+        // the working directory and then the arguments (argv[0] is filled in here)
+        char *argv[256];
+        int argc = 0;
+        const char *cwd = payload;
+        argv[argc++] = "unn";
+        for (char *at = payload + strlen(payload) + 1; at < payload + length && argc < 255; at += strlen(at) + 1) argv[argc++] = at;
+        argv[argc] = NULL;
+
+        int status = 0, stop = 0;
+        if (argc == 2 && strcmp(argv[1], "--shutdown") == 0) stop = 1;
+        else if (argc == 2 && strcmp(argv[1], "--stats") == 0) {
+                dprintf(fds[1], "cached files : %zu, hits : %zu, misses : %zu\n", server->fileCount, server->hits, server->misses);
+        } else {
+                int here = open(".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+                if (chdir(cwd) != 0) {
+                        dprintf(fds[2], "SERVER ERROR: Cannot change into '%s'\n", cwd);
+                        status = 1;
+                } else {
+                        fflush(stdout);
+                        fflush(stderr);
+                        int saved[3];
+                        for (int i = 0; i < 3; i++) {
+                                saved[i] = dup(i);
+                                dup2(fds[i], i);
+                        }
+                        clearerr(stdin);
+                        server->client = client;
+                        status = command(argc, argv, server);
+                        server->client = -1;
+                        fflush(stdout);
+                        fflush(stderr);
+                        for (int i = 0; i < 3; i++) {
+                                dup2(saved[i], i);
+                                close(saved[i]);
+                        }
+                        // no vm uses the table between requests so this is when one that got too big can start over
+                        if (server->symbols.count > SERVER_MAX_SYMBOLS) {
+                                symbol_table_free(&server->symbols);
+                                symbol_table_init(&server->symbols);
+                        }
+                }
+                if (here >= 0) {
+                        if (fchdir(here) != 0) perror("SERVER ERROR: Could not go back to the server directory");
+                        close(here);
+                }
+        }
+        for (int i = 0; i < 3; i++) close(fds[i]);
+        int32_t answer = status;
+        write_all(client, &answer, sizeof(answer));
+        free(payload);
+        return stop;
+}
+
+int server_run(const char *socketPath, ServerCommand command) {
+        struct sockaddr_un address;
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        const char *runtime = getenv("XDG_RUNTIME_DIR");
+        int len;
+        if (socketPath) len = snprintf(address.sun_path, sizeof(address.sun_path), "%s", socketPath);
+        else if (runtime && runtime[0]) len = snprintf(address.sun_path, sizeof(address.sun_path), "%s/%s", runtime, SERVER_SOCKET_NAME);
+        else len = snprintf(address.sun_path, sizeof(address.sun_path), SERVER_SOCKET_FALLBACK, (unsigned)getuid());
+        if (len < 0 || (size_t)len >= sizeof(address.sun_path)) {
+                fprintf(stderr, "SERVER ERROR: Socket path is too long\n");
+                return 1;
+        }
+
+        int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (listener < 0) {
+                perror("SERVER ERROR: Could not make a socket");
+                return 1;
+        }
+        // a socket left behind by a server that died gets replaced but a live one is left alone
+        if (connect(listener, (struct sockaddr *)&address, sizeof(address)) == 0) {
+                fprintf(stderr, "SERVER ERROR: A server is already running on '%s'\n", address.sun_path);
+                close(listener);
+                return 1;
+        }
+        close(listener);
+        listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        unlink(address.sun_path);
+        mode_t mask = umask(077); // only this user can send requests
+        int bound = listener >= 0 && bind(listener, (struct sockaddr *)&address, sizeof(address)) == 0 && listen(listener, 16) == 0;
+        umask(mask);
+        if (!bound) {
+                fprintf(stderr, "SERVER ERROR: Could not listen on '%s' : %s\n", address.sun_path, strerror(errno));
+                if (listener >= 0) close(listener);
+                return 1;
+        }
+
+        struct sigaction action;
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = on_signal; // no SA_RESTART so accept gives up when we are told to stop
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        signal(SIGPIPE, SIG_IGN);
+
+        Server server;
+        memset(&server, 0, sizeof(server));
+        server.keywords = lexer_keywords();
+        symbol_table_init(&server.symbols);
+        server.listener = listener;
+        server.client = -1;
+        fprintf(stderr, "unn server listening on %s\n", address.sun_path);
+
+        int stop = 0;
+        while (!stopping && !stop) {
+                int client = accept(listener, NULL, NULL);
+                if (client < 0) {
+                        if (errno == EINTR || errno == ECONNABORTED) continue;
+                        perror("SERVER ERROR: accept");
+                        break;
+                }
+                fcntl(client, F_SETFD, FD_CLOEXEC);
+                // requests are handled one at a time so a client that connects and never sends anything would hold up
+                // everyone else, reading its request gives up after a while instead
+                struct timeval timeout = {SERVER_REQUEST_TIMEOUT, 0};
+                setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+                stop = serve(&server, client, command);
+                close(client);
+        }
+
+        close(listener);
+        unlink(address.sun_path);
+        while (server.files) {
+                CachedFile *next = server.files->next;
+                free_file(server.files);
+                server.files = next;
+        }
+        freeTrie(server.keywords);
+        symbol_table_free(&server.symbols);
+        return 0;
+}
@@ -0,0 +1,71 @@
+// this is the header for the compile server, ./unn --server keeps running in the background and takes the same command lines
+// as ./unn from unn-client (Client.c) over a unix socket so nothing has to start up cold for every run
+//
+// what stays warm between requests
+//   the keyword trie of the lexer
+//   the symbol table every name gets interned into so names seen before are one lookup (cleared past SERVER_MAX_SYMBOLS)
+//   the syntax tree of the last SERVER_MAX_FILES files it parsed, keyed by canonical path with the mtime size and hash of
+//   the contents, a file whose mtime and size did not change is not even read again and one that only got touched is not
+//   lexed, the tokens are freed as soon as the tree is built (nodes carry their own line and col) so a cached file costs
+//   about as much as its tree, the least recently used file goes first when the cache is full and files that were deleted
+//   get dropped whenever something has to be parsed
+// requests are handled one at a time, compiling happens in the server so the caches fill up but the program itself runs
+// in a forked child so a crash or a loop that never ends only takes out that one request (the client can ctrl c it)
+
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "Parser.h" // cached trees
+#include "VM.h" // the symbol table
+
+#define SERVER_MAGIC 0x534E4E55u // "UNNS" at the start of every request
+#define SERVER_SOCKET_NAME "unn.sock" // default socket inside $XDG_RUNTIME_DIR
+#define SERVER_SOCKET_FALLBACK "/tmp/unn-%u.sock" // default socket with the uid filled in when there is no runtime dir
+#define SERVER_MAX_REQUEST (1 << 20) // bytes of working directory and arguments a request can have
+#define SERVER_REQUEST_TIMEOUT 2 // seconds a client gets to send its request before the server gives up on it
+#ifndef SERVER_MAX_FILES
+#define SERVER_MAX_FILES 256 // files kept in the cache
+#endif
+#ifndef SERVER_MAX_SYMBOLS
+#define SERVER_MAX_SYMBOLS (1 << 16) // names the symbol table can pile up before it starts over
+#endif
+
+// one file kept between requests
+typedef struct CachedFile {
+        char *path; // canonical path
+        long long mtime; // nanoseconds
+        long long size;
+        unsigned long long hash; // of the contents
+        Arena arena;
+        Node *program;
+        int hasImports; // starts with imports so it gets built as modules
+        struct CachedFile *next; // the list is kept most recently used first
+} CachedFile;
+
+typedef struct Server {
+        TrieNode *keywords;
+        SymbolTable symbols; // the vm of every request interns into this one
+        CachedFile *files;
+        size_t fileCount;
+        int listener; // socket the server accepts on (closed in the children)
+        int client; // socket of the request being handled
+        size_t hits; // files that came out of the cache
+        size_t misses; // files that had to be lexed and parsed
+} Server;
+
+// what the server runs for every request, the driver in main.c with server set (and NULL when running normally)
+typedef int (*ServerCommand)(int argc, char **argv, Server *server);
+
+// serves requests on socketPath (NULL for the default) until it gets --shutdown or a signal, returns the exit status
+int server_run(const char *socketPath, ServerCommand command);
+
+// gives the tree of path, lexing and parsing it only if it changed since the last request
+// returns NULL after printing the errors if the file cannot be read or has errors (files with errors are not kept)
+CachedFile *server_source(Server *server, const char *path, int jobs);
+// called right before a program starts running, without a server it just returns 1
+// in the server it forks and returns 1 in the child, the parent waits for the child and returns 0 with *status set
+int server_fork(Server *server, int *status);
+// ends the child once the program finished, does nothing without a server
+void server_exit(Server *server, int status);
+
+#endif
@@ -0,0 +1,95 @@
+// here is the symbol table it is a string interner using open addressing (linear probing) with FNV-1a as the hash function
+
+#include "Symbol_Table.h"
+
+// FNV-1a hash simple and good enough for identifiers
+static unsigned int hash_name(const char *name) {
+        unsigned int hash = 2166136261u;
+        while (*name) {
+                hash ^= (unsigned char)*name++;
+                hash *= 16777619u;
+        }
+        return hash;
+}
+
+void symbol_table_init(SymbolTable *table) {
+        table->names = NULL;
+        table->count = 0;
+        table->cap = 0;
+        table->bucketCount = SYMBOL_TABLE_LEN;
+        table->buckets = calloc(table->bucketCount, sizeof(int));
+        if (!table->buckets) {
+                fprintf(stderr, "SYMBOL ERROR: Unable to allocate symbol table\n");
+                exit(1);
+        }
+}
+
+void symbol_table_free(SymbolTable *table) {
+        for (size_t i = 0; i < table->count; i++) {
+                free(table->names[i]);
+        }
+        free(table->names);
+        free(table->buckets);
+        table->names = NULL;
+        table->buckets = NULL;
+        table->count = table->cap = table->bucketCount = 0;
+}
+
+// doubles the bucket array and reinserts every id once the table is over half full
+static void grow_buckets(SymbolTable *table) {
+        size_t newCount = table->bucketCount * 2;
+        int *newBuckets = calloc(newCount, sizeof(int));
+        if (!newBuckets) {
+                fprintf(stderr, "SYMBOL ERROR: Unable to grow symbol table\n");
+                exit(1);
+        }
+        for (size_t id = 0; id < table->count; id++) {
+                size_t slot = hash_name(table->names[id]) & (newCount - 1);
+                while (newBuckets[slot]) slot = (slot + 1) & (newCount - 1);
+                newBuckets[slot] = (int)id + 1;
+        }
+        free(table->buckets);
+        table->buckets = newBuckets;
+        table->bucketCount = newCount;
+}
+
+int symbol_find(const SymbolTable *table, const char *name) {
+        size_t slot = hash_name(name) & (table->bucketCount - 1);
+        // walk the probe sequence until we hit the name or an empty bucket
+        while (table->buckets[slot]) {
+                int id = table->buckets[slot] - 1;
+                if (strcmp(table->names[id], name) == 0) return id;
+                slot = (slot + 1) & (table->bucketCount - 1);
+        }
+        return -1;
+}
+
+int symbol_intern(SymbolTable *table, const char *name) {
+        int id = symbol_find(table, name);
+        if (id >= 0) return id;
+
+        if ((table->count + 1) * 2 > table->bucketCount) grow_buckets(table);
+        // dynamic array for the names same as the token stream
+        if (table->count >= table->cap) {
+                size_t newCap = table->cap ? table->cap * 2 : SYMBOL_TABLE_LEN;
+                char **newNames = realloc(table->names, sizeof(char *) * newCap);
+                if (!newNames) {
+                        fprintf(stderr, "SYMBOL ERROR: Unable to grow symbol table\n");
+                        exit(1);
+                }
+                table->names = newNames;
+                table->cap = newCap;
+        }
+        id = (int)table->count;
+        table->names[table->count++] = strdup(name);
+
+        size_t slot = hash_name(name) & (table->bucketCount - 1);
+        while (table->buckets[slot]) slot = (slot + 1) & (table->bucketCount - 1);
+        table->buckets[slot] = id + 1;
+        return id;
+}
+
+const char *symbol_name(const SymbolTable *table, int id) {
+        if (id < 0 || (size_t)id >= table->count) return "<unknown>";
+        return table->names[id];
+}
@@ -0,0 +1,32 @@
+// this is the header for the symbol table every name the compiler and vm care about (variables, properties, functions, classes)
+// gets interned here once and from then on is just an int id so comparing two names is an int compare instead of a strcmp
+
+#ifndef SYMBOL_TABLE_H
+#define SYMBOL_TABLE_H
+
+#include <stdio.h> // standard i/o lib for C
+#include <stdlib.h> // standard lib for C
+#include <string.h> // lib for string functions like strcmp()
+
+#define SYMBOL_TABLE_LEN 64 // initial bucket count has to stay a power of two so we can mask instead of mod
+
+typedef struct {
+        char **names; // names[id] is the interned string for that id
+        size_t count; // number of interned names
+        size_t cap; // capacity of names
+        int *buckets; // open addressing hash table holding id + 1 so that 0 means empty
+        size_t bucketCount; // always a power of two
+} SymbolTable;
+
+// sets up an empty table
+void symbol_table_init(SymbolTable *table);
+// frees every interned name and the table memory
+void symbol_table_free(SymbolTable *table);
+// returns the id for name adding it to the table if it has not been seen before
+int symbol_intern(SymbolTable *table, const char *name);
+// same as symbol_intern but returns -1 instead of adding the name
+int symbol_find(const SymbolTable *table, const char *name);
+// returns the string for an id
+const char *symbol_name(const SymbolTable *table, int id);
+
+#endif
@@ -0,0 +1,18 @@
+#!/bin/sh
+# runs every test program and compares what it prints with its "// prints" lines
+# usage: sh Tests/run.sh [path to unn]
+UNN=${1:-./unn}
+failed=0
+for file in Tests/*.unn; do
+        expected=$(sed -n 's|^// prints ||p' "$file")
+        actual=$("$UNN" "$file" 2>&1)
+        if [ "$actual" = "$expected" ]; then
+                echo "ok   $file"
+        else
+                echo "FAIL $file"
+                echo "expected:"; echo "$expected"
+                echo "got:"; echo "$actual"
+                failed=1
+        fi
+done
+exit $failed
@@ -0,0 +1,881 @@
+// here is the virtual machine it runs the bytecode from Bytecode.c
+//
+// dispatch uses GCC's computed goto (labels as values) when the compiler supports it, every handler jumps straight to the next
+// handler through a table instead of going back to the top of a switch which gives the branch predictor one indirect jump per opcode
+// to learn instead of one for the whole loop, build with -DVM_NO_COMPUTED_GOTO to get the plain switch version for comparison
+
+#include <math.h> // pow and fmod
+#include <time.h> // clock_gettime for the clock() built in
+#include "Bytecode.h"
+#include "JIT.h" // machine code for hot functions
+
+#if defined(__GNUC__) && !defined(VM_NO_COMPUTED_GOTO)
+#define VM_COMPUTED_GOTO
+#endif
+
+static void *vm_alloc(size_t size) {
+        void *memory = malloc(size);
+        if (!memory) {
+                fprintf(stderr, "RUNTIME ERROR: Out of memory\n");
+                exit(1);
+        }
+        return memory;
+}
+
+// links an object into the list vm_free walks
+static void track(VM *vm, Obj *obj) {
+        obj->next = vm->objects;
+        vm->objects = obj;
+}
+
+Value vm_string(VM *vm, const char *chars, size_t length) {
+        String *string = vm_alloc(sizeof(String) + length + 1);
+        string->obj.extra = NULL;
+        string->length = length;
+        memcpy(string->chars, chars, length);
+        string->chars[length] = '\0';
+        track(vm, &string->obj);
+
+        Value value;
+        value.type = VAL_STRING;
+        value.as.string = string;
+        return value;
+}
+
+static Shape *new_shape(Shape *parent, int name) {
+        Shape *shape = vm_alloc(sizeof(Shape));
+        shape->parent = parent;
+        shape->slotCount = parent ? parent->slotCount + 1 : 0;
+        shape->names = vm_alloc(sizeof(int) * (shape->slotCount + 1));
+        if (parent) {
+                memcpy(shape->names, parent->names, sizeof(int) * parent->slotCount);
+                shape->names[parent->slotCount] = name;
+        }
+        shape->transitions = NULL;
+        shape->transitionCount = 0;
+        return shape;
+}
+
+static void free_shape(Shape *shape) {
+        for (int i = 0; i < shape->transitionCount; i++) free_shape(shape->transitions[i]);
+        free(shape->transitions);
+        free(shape->names);
+        free(shape);
+}
+
+Shape *shape_add(Shape *shape, int name) {
+        for (int i = 0; i < shape->transitionCount; i++) {
+                Shape *next = shape->transitions[i];
+                if (next->names[shape->slotCount] == name) return next;
+        }
+        Shape *next = new_shape(shape, name);
+        Shape **newTransitions = realloc(shape->transitions, sizeof(Shape *) * (shape->transitionCount + 1));
+        if (!newTransitions) {
+                fprintf(stderr, "RUNTIME ERROR: Out of memory\n");
+                exit(1);
+        }
+        shape->transitions = newTransitions;
+        shape->transitions[shape->transitionCount++] = next;
+        return next;
+}
+
+int shape_find(const Shape *shape, int name) {
+        for (int slot = shape->slotCount - 1; slot >= 0; slot--) {
+                if (shape->names[slot] == name) return slot;
+        }
+        return -1;
+}
+
+Function *class_find_method(const Class *klass, int name) {
+        for (; klass; klass = klass->parent) {
+                for (int i = 0; i < klass->methodCount; i++) {
+                        if (klass->methodNames[i] == name) return klass->methods[i];
+                }
+        }
+        return NULL;
+}
+
+// dynamic array append used for the global function and class lists
+static void append(void ***items, size_t *count, size_t *cap, void *item) {
+        if (*count >= *cap) {
+                size_t newCap = *cap ? *cap * 2 : 16;
+                void **newItems = realloc(*items, sizeof(void *) * newCap);
+                if (!newItems) {
+                        fprintf(stderr, "RUNTIME ERROR: Out of memory\n");
+                        exit(1);
+                }
+                *items = newItems;
+                *cap = newCap;
+        }
+        (*items)[(*count)++] = item;
+}
+
+Function *vm_new_function(VM *vm, const char *name) {
+        Function *function = vm_alloc(sizeof(Function));
+        memset(function, 0, sizeof(Function));
+        function->name = symbol_intern(vm->symbols, name);
+        append((void ***)&vm->functions, &vm->functionCount, &vm->functionCap, function);
+        return function;
+}
+
+Class *vm_new_class(VM *vm, const char *name) {
+        Class *klass = vm_alloc(sizeof(Class));
+        memset(klass, 0, sizeof(Class));
+        klass->name = symbol_intern(vm->symbols, name);
+        klass->shape = vm->rootShape;
+        klass->constructor = vm_new_function(vm, name);
+        append((void ***)&vm->classes, &vm->classCount, &vm->classCap, klass);
+        return klass;
+}
+
+int vm_find_global(VM *vm, const char *name) {
+        int symbol = symbol_find(vm->symbols, name);
+        if (symbol < 0) return -1;
+        for (size_t i = 0; i < vm->globalCount; i++) {
+                if (vm->globalNames[i] == symbol) return (int)i;
+        }
+        return -1;
+}
+
+int vm_global(VM *vm, const char *name) {
+        int slot = vm_find_global(vm, name);
+        if (slot >= 0) return slot;
+        if (vm->globalCount >= vm->globalCap) {
+                size_t newCap = vm->globalCap ? vm->globalCap * 2 : 16;
+                Value *newGlobals = realloc(vm->globals, sizeof(Value) * newCap);
+                int *newNames = realloc(vm->globalNames, sizeof(int) * newCap);
+                if (!newGlobals || !newNames) {
+                        fprintf(stderr, "RUNTIME ERROR: Out of memory\n");
+                        exit(1);
+                }
+                vm->globals = newGlobals;
+                vm->globalNames = newNames;
+                vm->globalCap = newCap;
+        }
+        vm->globals[vm->globalCount].type = VAL_NIL;
+        vm->globalNames[vm->globalCount] = symbol_intern(vm->symbols, name);
+        return (int)vm->globalCount++;
+}
+
+void print_value(FILE *out, Value value) {
+        switch (value.type) {
+                case VAL_NIL: fprintf(out, "nil"); break;
+                case VAL_INT: fprintf(out, "%lld", value.as.i); break;
+                case VAL_DOUBLE: fprintf(out, "%.15g", value.as.d); break;
+                case VAL_STRING: fprintf(out, "%s", value.as.string->chars); break;
+                case VAL_FUNCTION: fprintf(out, "<function>"); break;
+                case VAL_NATIVE: fprintf(out, "<native>"); break;
+                case VAL_CLASS: fprintf(out, "<class>"); break;
+                case VAL_OBJECT: fprintf(out, "<object>"); break;
+                case VAL_METHOD: fprintf(out, "<method>"); break;
+        }
+}
+
+// print(a, b, ...) prints its arguments separated by spaces
+static int native_print(VM *vm, Value *args, int count, Value *result) {
+        (void)vm;
+        for (int i = 0; i < count; i++) {
+                if (i) putchar(' ');
+                print_value(stdout, args[i]);
+        }
+        putchar('\n');
+        result->type = VAL_NIL;
+        return 1;
+}
+
+// clock() returns seconds as a double so programs can time themselves
+static int native_clock(VM *vm, Value *args, int count, Value *result) {
+        (void)vm;
+        (void)args;
+        (void)count;
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        result->type = VAL_DOUBLE;
+        result->as.d = (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+        return 1;
+}
+
+static void define_native(VM *vm, const char *name, NativeFn native) {
+        int slot = vm_global(vm, name);
+        vm->globals[slot].type = VAL_NATIVE;
+        vm->globals[slot].as.native = native;
+}
+
+void vm_init(VM *vm) {
+        vm_init_symbols(vm, NULL);
+}
+
+void vm_init_symbols(VM *vm, SymbolTable *symbols) {
+        memset(vm, 0, sizeof(VM));
+        symbol_table_init(&vm->ownSymbols);
+        vm->symbols = symbols ? symbols : &vm->ownSymbols;
+        vm->stack = vm_alloc(sizeof(Value) * STACK_LEN);
+        vm->stackEnd = vm->stack + STACK_LEN;
+        vm->rootShape = new_shape(NULL, -1);
+        define_native(vm, "print", native_print);
+        define_native(vm, "clock", native_clock);
+        vm->jit = jit_available();
+}
+
+void vm_free(VM *vm) {
+        Obj *obj = vm->objects;
+        while (obj) {
+                Obj *next = obj->next;
+                free(obj->extra);
+                free(obj);
+                obj = next;
+        }
+        for (size_t i = 0; i < vm->functionCount; i++) {
+                Function *function = vm->functions[i];
+                free(function->code);
+                free(function->lines);
+                free(function->constants);
+                free(function->caches);
+                jit_free(function);
+                free(function);
+        }
+        for (size_t i = 0; i < vm->classCount; i++) {
+                free(vm->classes[i]->methodNames);
+                free(vm->classes[i]->methods);
+                free(vm->classes[i]);
+        }
+        free(vm->functions);
+        free(vm->classes);
+        free(vm->globals);
+        free(vm->globalNames);
+        free(vm->stack);
+        free_shape(vm->rootShape);
+        symbol_table_free(&vm->ownSymbols);
+}
+
+// an instance and its slots are allocated together the slots only move out when fields get added later
+static Instance *new_instance(VM *vm, Class *klass) {
+        int cap = klass->shape->slotCount > 4 ? klass->shape->slotCount : 4;
+        Instance *object = vm_alloc(sizeof(Instance) + sizeof(Value) * cap);
+        object->klass = klass;
+        object->shape = klass->shape;
+        object->slots = (Value *)(object + 1);
+        object->slotCap = cap;
+        object->obj.extra = NULL;
+        for (int i = 0; i < cap; i++) object->slots[i].type = VAL_NIL;
+        track(vm, &object->obj);
+        return object;
+}
+
+static int runtime_error(VM *vm, const char *format, const char *name) {
+        snprintf(vm->error, sizeof(vm->error), format, name);
+        return 0;
+}
+
+static const char *type_name(ValueType type) {
+        static const char *names[] = { "nil", "int", "double", "string", "function", "native", "class", "object", "method" };
+        return names[type];
+}
+
+static int is_truthy(const Value *value) {
+        switch (value->type) {
+                case VAL_NIL: return 0;
+                case VAL_INT: return value->as.i != 0;
+                case VAL_DOUBLE: return value->as.d != 0.0;
+                default: return 1;
+        }
+}
+
+static double as_double(const Value *value) {
+        return value->type == VAL_INT ? (double)value->as.i : value->as.d;
+}
+
+static int is_numeric(const Value *value) {
+        return value->type == VAL_INT || value->type == VAL_DOUBLE;
+}
+
+// writes a value as text for string concatenation
+static size_t value_text(const Value *value, char *buffer, size_t size) {
+        switch (value->type) {
+                case VAL_INT: return (size_t)snprintf(buffer, size, "%lld", value->as.i);
+                case VAL_DOUBLE: return (size_t)snprintf(buffer, size, "%.15g", value->as.d);
+                case VAL_NIL: return (size_t)snprintf(buffer, size, "nil");
+                default: return (size_t)snprintf(buffer, size, "<%s>", type_name(value->type));
+        }
+}
+
+static int concat(VM *vm, Value *dst, const Value *a, const Value *b) {
+        char left[64], right[64];
+        const char *l = left, *r = right;
+        size_t llen, rlen;
+        if (a->type == VAL_STRING) { l = a->as.string->chars; llen = a->as.string->length; }
+        else llen = value_text(a, left, sizeof(left));
+        if (b->type == VAL_STRING) { r = b->as.string->chars; rlen = b->as.string->length; }
+        else rlen = value_text(b, right, sizeof(right));
+
+        String *string = vm_alloc(sizeof(String) + llen + rlen + 1);
+        string->obj.extra = NULL;
+        string->length = llen + rlen;
+        memcpy(string->chars, l, llen);
+        memcpy(string->chars + llen, r, rlen);
+        string->chars[llen + rlen] = '\0';
+        track(vm, &string->obj);
+        dst->type = VAL_STRING;
+        dst->as.string = string;
+        return 1;
+}
+
+static long long int_pow(long long base, long long exponent) {
+        unsigned long long result = 1, b = (unsigned long long)base;
+        while (exponent > 0) {
+                if (exponent & 1) result *= b;
+                b *= b;
+                exponent >>= 1;
+        }
+        return (long long)result;
+}
+
+// slow path for arithmetic anything that isnt int op int ends up here
+// ints wrap around instead of overflowing (through unsigned math) so the result is the same on every machine
+static int arith(VM *vm, OpCode op, Value *dst, const Value *a, const Value *b) {
+        if (op == OP_ADD && (a->type == VAL_STRING || b->type == VAL_STRING)) return concat(vm, dst, a, b);
+        if (!is_numeric(a) || !is_numeric(b)) {
+                char message[96];
+                snprintf(message, sizeof(message), "Unsupported operand types for %s : %s and %%s", opNames[op], type_name(a->type));
+                return runtime_error(vm, message, type_name(b->type));
+        }
+        if (a->type == VAL_INT && b->type == VAL_INT) {
+                long long x = a->as.i, y = b->as.i, result;
+                unsigned long long ux = (unsigned long long)x, uy = (unsigned long long)y;
+                switch (op) {
+                        case OP_ADD: result = (long long)(ux + uy); break;
+                        case OP_SUB: result = (long long)(ux - uy); break;
+                        case OP_MUL: result = (long long)(ux * uy); break;
+                        case OP_DIV: case OP_MOD:
+                                if (y == 0) return runtime_error(vm, "Division by zero%s", "");
+                                if (y == -1) result = op == OP_DIV ? (long long)(0 - ux) : 0; // LLONG_MIN / -1 would trap
+                                else result = op == OP_DIV ? x / y : x % y;
+                                break;
+                        case OP_POW:
+                                if (y < 0) {
+                                        dst->type = VAL_DOUBLE;
+                                        dst->as.d = pow((double)x, (double)y);
+                                        return 1;
+                                }
+                                result = int_pow(x, y);
+                                break;
+                        case OP_BAND: result = x & y; break;
+                        case OP_BOR: result = x | y; break;
+                        case OP_BXOR: result = x ^ y; break;
+                        case OP_SHL: result = (long long)(ux << (y & 63)); break;
+                        case OP_SHR: result = x >> (y & 63); break;
+                        default: return runtime_error(vm, "Bad arithmetic opcode%s", "");
+                }
+                dst->type = VAL_INT;
+                dst->as.i = result;
+                return 1;
+        }
+        double x = as_double(a), y = as_double(b), result;
+        switch (op) {
+                case OP_ADD: result = x + y; break;
+                case OP_SUB: result = x - y; break;
+                case OP_MUL: result = x * y; break;
+                case OP_DIV: result = x / y; break;
+                case OP_MOD: result = fmod(x, y); break;
+                case OP_POW: result = pow(x, y); break;
+                default: return runtime_error(vm, "Bitwise operators need ints%s", "");
+        }
+        dst->type = VAL_DOUBLE;
+        dst->as.d = result;
+        return 1;
+}
+
+static int values_equal(const Value *a, const Value *b) {
+        if (is_numeric(a) && is_numeric(b)) {
+                if (a->type == VAL_INT && b->type == VAL_INT) return a->as.i == b->as.i;
+                return as_double(a) == as_double(b);
+        }
+        if (a->type != b->type) return 0;
+        switch (a->type) {
+                case VAL_NIL: return 1;
+                case VAL_STRING: return a->as.string->length == b->as.string->length && memcmp(a->as.string->chars, b->as.string->chars, a->as.string->length) == 0;
+                case VAL_FUNCTION: return a->as.function == b->as.function;
+                case VAL_NATIVE: return a->as.native == b->as.native;
+                case VAL_CLASS: return a->as.klass == b->as.klass;
+                case VAL_OBJECT: return a->as.object == b->as.object;
+                case VAL_METHOD: return a->as.method->method == b->as.method->method && values_equal(&a->as.method->receiver, &b->as.method->receiver);
+                default: return 0;
+        }
+}
+
+// a < b (or a <= b when orEqual) for numbers and strings
+static int less_than(VM *vm, const Value *a, const Value *b, int orEqual, int *result) {
+        if (a->type == VAL_INT && b->type == VAL_INT) {
+                *result = orEqual ? a->as.i <= b->as.i : a->as.i < b->as.i;
+                return 1;
+        }
+        if (is_numeric(a) && is_numeric(b)) {
+                double x = as_double(a), y = as_double(b);
+                *result = orEqual ? x <= y : x < y;
+                return 1;
+        }
+        if (a->type == VAL_STRING && b->type == VAL_STRING) {
+                int cmp = strcmp(a->as.string->chars, b->as.string->chars);
+                *result = orEqual ? cmp <= 0 : cmp < 0;
+                return 1;
+        }
+        char message[96];
+        snprintf(message, sizeof(message), "Cannot compare %s with %%s", type_name(a->type));
+        return runtime_error(vm, message, type_name(b->type));
+}
+
+// property read that missed the inline cache looks the name up and refills the cache
+static int get_property(VM *vm, InlineCache *cache, const Value *receiver, Value *dst) {
+        if (receiver->type != VAL_OBJECT) return runtime_error(vm, "Only objects have properties not %s", type_name(receiver->type));
+        Instance *object = receiver->as.object;
+        int slot = shape_find(object->shape, cache->name);
+        if (slot >= 0) {
+                cache->shape = object->shape;
+                cache->slot = slot;
+                cache->transition = NULL;
+                *dst = object->slots[slot];
+                return 1;
+        }
+        Function *method = class_find_method(object->klass, cache->name);
+        if (method) {
+                // the object goes along with the method so it still has its this when it gets called later
+                BoundMethod *bound = vm_alloc(sizeof(BoundMethod));
+                bound->obj.extra = NULL;
+                bound->receiver = *receiver;
+                bound->method = method;
+                track(vm, &bound->obj);
+                dst->type = VAL_METHOD;
+                dst->as.method = bound;
+                return 1;
+        }
+        return runtime_error(vm, "Undefined property '%s'", symbol_name(vm->symbols, cache->name));
+}
+
+// property write that missed the inline cache, writing a field the object doesnt have yet moves it to a new shape
+static int set_property(VM *vm, InlineCache *cache, const Value *receiver, const Value *value) {
+        if (receiver->type != VAL_OBJECT) return runtime_error(vm, "Only objects have properties not %s", type_name(receiver->type));
+        Instance *object = receiver->as.object;
+        Shape *before = object->shape;
+        int slot = shape_find(before, cache->name);
+        Shape *after = NULL;
+        if (slot < 0) {
+                after = shape_add(before, cache->name);
+                slot = after->slotCount - 1;
+                if (slot >= object->slotCap) {
+                        int newCap = object->slotCap * 2;
+                        Value *newSlots = vm_alloc(sizeof(Value) * newCap);
+                        memcpy(newSlots, object->slots, sizeof(Value) * object->slotCap);
+                        for (int i = object->slotCap; i < newCap; i++) newSlots[i].type = VAL_NIL;
+                        // the first slots live inside the instance allocation only slots that moved out get freed
+                        free(object->obj.extra);
+                        object->obj.extra = newSlots;
+                        object->slots = newSlots;
+                        object->slotCap = newCap;
+                }
+                object->shape = after;
+        }
+        object->slots[slot] = *value;
+        cache->shape = before;
+        cache->slot = slot;
+        cache->transition = after;
+        return 1;
+}
+
+// pushes a frame for function with its registers starting at base the result goes into ret when it returns
+static int push_frame(VM *vm, Function *function, Value *base, Value *ret, int argc) {
+        if (argc != function->arity) {
+                char message[128];
+                snprintf(message, sizeof(message), "'%%s' expects %d arguments but got %d", function->arity, argc);
+                return runtime_error(vm, message, symbol_name(vm->symbols, function->name));
+        }
+        if (vm->frameCount >= FRAMES_LEN || base + function->registers > vm->stackEnd) return runtime_error(vm, "Stack overflow%s", "");
+        Frame *frame = &vm->frames[vm->frameCount++];
+        frame->function = function;
+        frame->pc = function->code;
+        frame->base = base;
+        frame->ret = ret;
+        return 1;
+}
+
+// calls anything callable that is in base[0] with argc arguments after it
+static int call_value(VM *vm, Value *base, int argc) {
+        switch (base->type) {
+                case VAL_FUNCTION: {
+                        Function *function = base->as.function;
+                        if (vm->jit && function->jitState != JIT_UNSUPPORTED) {
+                                if (function->jitState == JIT_NONE && ++function->calls >= JIT_CALL_THRESHOLD && jit_compile(vm, function)) vm->jitCompiled++;
+                                // compiled code runs right here without a frame and only falls back to one if it bails
+                                if (function->jitState == JIT_COMPILED && argc == function->arity && base + 1 + function->registers <= vm->stackEnd &&
+                                    jit_call(function, base + 1, base)) return 1;
+                        }
+                        return push_frame(vm, function, base + 1, base, argc);
+                }
+                case VAL_NATIVE:
+                        return base->as.native(vm, base + 1, argc, base);
+                case VAL_CLASS: {
+                        // the new object takes the place of the class so it becomes this for the constructor
+                        Class *klass = base->as.klass;
+                        base->type = VAL_OBJECT;
+                        base->as.object = new_instance(vm, klass);
+                        return push_frame(vm, klass->constructor, base, base, argc);
+                }
+                case VAL_METHOD: {
+                        // the object takes the place of the method so it is this in register 0 like for INVOKE
+                        BoundMethod *bound = base->as.method;
+                        *base = bound->receiver;
+                        return push_frame(vm, bound->method, base, base, argc);
+                }
+                default:
+                        return runtime_error(vm, "Cannot call a value of type %s", type_name(base->type));
+        }
+}
+
+void vm_print_profile(VM *vm, FILE *out) {
+        int order[OP_COUNT];
+        unsigned long long total = 0;
+        for (int i = 0; i < OP_COUNT; i++) {
+                order[i] = i;
+                total += vm->counts[i];
+        }
+        // insertion sort is plenty for under a hundred opcodes
+        for (int i = 1; i < OP_COUNT; i++) {
+                int op = order[i], j = i;
+                while (j > 0 && vm->counts[order[j - 1]] < vm->counts[op]) {
+                        order[j] = order[j - 1];
+                        j--;
+                }
+                order[j] = op;
+        }
+        fprintf(out, "---- opcode profile (%llu instructions) ----\n", total);
+        for (int i = 0; i < OP_COUNT && vm->counts[order[i]]; i++) {
+                fprintf(out, "%-10s %15llu  %6.2f%%\n", opNames[order[i]], vm->counts[order[i]], total ? 100.0 * vm->counts[order[i]] / total : 0.0);
+        }
+}
+
+int vm_run(VM *vm, Function *main) {
+        register uint32_t *pc;
+        register Value *base;
+        Function *function;
+        Value *k;
+        uint32_t ins;
+        const int profiling = vm->profile;
+        unsigned long long *counts = vm->counts;
+
+        vm->frameCount = 0;
+        vm->error[0] = '\0';
+        for (int i = 0; i < main->registers; i++) vm->stack[i].type = VAL_NIL;
+        if (!push_frame(vm, main, vm->stack, vm->stack, 0)) goto error;
+
+// reloads the cached frame state after a call or return
+#define LOAD_FRAME() do { \
+                Frame *frame = &vm->frames[vm->frameCount - 1]; \
+                function = frame->function; \
+                pc = frame->pc; \
+                base = frame->base; \
+                k = function->constants; \
+        } while (0)
+#define SAVE_PC() (vm->frames[vm->frameCount - 1].pc = pc)
+#define RA (base[ARG_A(ins)])
+#define RB (base[ARG_B(ins)])
+#define RC (base[ARG_C(ins)])
+#define KB (k[ARG_B(ins)])
+#define KC (k[ARG_C(ins)])
+
+#ifdef VM_COMPUTED_GOTO
+#define OPCODE_LABEL(name) &&op_##name,
+        static void *dispatchTable[OP_COUNT] = { OPCODES(OPCODE_LABEL) };
+#undef OPCODE_LABEL
+#define CASE(name) op_##name:
+#define DISPATCH() do { ins = *pc++; if (profiling) counts[OP(ins)]++; goto *dispatchTable[OP(ins)]; } while (0)
+#define BEGIN_DISPATCH() DISPATCH();
+#define END_DISPATCH()
+#else
+#define CASE(name) case OP_##name:
+#define DISPATCH() goto dispatch
+#define BEGIN_DISPATCH() dispatch: ins = *pc++; if (profiling) counts[OP(ins)]++; switch (OP(ins)) {
+#define END_DISPATCH() default: runtime_error(vm, "Unknown opcode%s", ""); goto error; }
+#endif
+
+// int op int and double op double are done inline everything else goes through arith
+#define ARITH(name, slowOp, intExpr, doubleOp, right) CASE(name) { \
+                const Value *a = &RB, *b = &(right); \
+                if (a->type == VAL_INT && b->type == VAL_INT) { \
+                        unsigned long long x = (unsigned long long)a->as.i, y = (unsigned long long)b->as.i; \
+                        RA.as.i = (long long)(intExpr); \
+                        RA.type = VAL_INT; \
+                } else if (a->type == VAL_DOUBLE && b->type == VAL_DOUBLE) { \
+                        RA.as.d = a->as.d doubleOp b->as.d; \
+                        RA.type = VAL_DOUBLE; \
+                } else if (!arith(vm, slowOp, &RA, a, b)) goto error; \
+                DISPATCH(); \
+        }
+#define ARITH_SLOW(name, right) CASE(name) { \
+                if (!arith(vm, OP_##name, &RA, &RB, &(right))) goto error; \
+                DISPATCH(); \
+        }
+// compare and branch superinstructions jump by the offset in the next word when the comparison is false
+#define BRANCH(cond) do { int32_t offset = (int32_t)*pc++; if (!(cond)) pc += offset; } while (0)
+#define IF_LESS(name, a, b, orEqual) CASE(name) { \
+                const Value *x = (a), *y = (b); \
+                int result; \
+                if (x->type == VAL_INT && y->type == VAL_INT) result = orEqual ? x->as.i <= y->as.i : x->as.i < y->as.i; \
+                else if (!less_than(vm, x, y, orEqual, &result)) goto error; \
+                BRANCH(result); \
+                DISPATCH(); \
+        }
+
+        LOAD_FRAME();
+        BEGIN_DISPATCH()
+
+        CASE(MOVE) {
+                RA = RB;
+                DISPATCH();
+        }
+        CASE(LOADI) {
+                RA.type = VAL_INT;
+                RA.as.i = ARG_sBx(ins);
+                DISPATCH();
+        }
+        CASE(LOADK) {
+                RA = k[ARG_Bx(ins)];
+                DISPATCH();
+        }
+        CASE(LOADNIL) {
+                RA.type = VAL_NIL;
+                DISPATCH();
+        }
+        CASE(GETGLOBAL) {
+                RA = vm->globals[ARG_Bx(ins)];
+                DISPATCH();
+        }
+        CASE(SETGLOBAL) {
+                vm->globals[ARG_Bx(ins)] = RA;
+                DISPATCH();
+        }
+        ARITH(ADD, OP_ADD, x + y, +, RC)
+        ARITH(SUB, OP_SUB, x - y, -, RC)
+        ARITH(MUL, OP_MUL, x * y, *, RC)
+        ARITH_SLOW(DIV, RC)
+        ARITH_SLOW(MOD, RC)
+        ARITH_SLOW(POW, RC)
+        ARITH(ADDK, OP_ADD, x + y, +, KC)
+        ARITH(SUBK, OP_SUB, x - y, -, KC)
+        ARITH(MULK, OP_MUL, x * y, *, KC)
+        CASE(DIVK) {
+                if (!arith(vm, OP_DIV, &RA, &RB, &KC)) goto error;
+                DISPATCH();
+        }
+        CASE(MODK) {
+                if (!arith(vm, OP_MOD, &RA, &RB, &KC)) goto error;
+                DISPATCH();
+        }
+        CASE(ADDI) {
+                const Value *a = &RB;
+                if (a->type == VAL_INT) {
+                        RA.as.i = (long long)((unsigned long long)a->as.i + (unsigned long long)(long long)ARG_sC(ins));
+                        RA.type = VAL_INT;
+                } else {
+                        Value imm;
+                        imm.type = VAL_INT;
+                        imm.as.i = ARG_sC(ins);
+                        if (!arith(vm, OP_ADD, &RA, a, &imm)) goto error;
+                }
+                DISPATCH();
+        }
+        ARITH_SLOW(BAND, RC)
+        ARITH_SLOW(BOR, RC)
+        ARITH_SLOW(BXOR, RC)
+        ARITH_SLOW(SHL, RC)
+        ARITH_SLOW(SHR, RC)
+        CASE(EQ) {
+                int result = values_equal(&RB, &RC);
+                RA.type = VAL_INT;
+                RA.as.i = result;
+                DISPATCH();
+        }
+        CASE(NE) {
+                int result = !values_equal(&RB, &RC);
+                RA.type = VAL_INT;
+                RA.as.i = result;
+                DISPATCH();
+        }
+        CASE(LT) {
+                int result;
+                if (!less_than(vm, &RB, &RC, 0, &result)) goto error;
+                RA.type = VAL_INT;
+                RA.as.i = result;
+                DISPATCH();
+        }
+        CASE(LE) {
+                int result;
+                if (!less_than(vm, &RB, &RC, 1, &result)) goto error;
+                RA.type = VAL_INT;
+                RA.as.i = result;
+                DISPATCH();
+        }
+        CASE(NEG) {
+                const Value *a = &RB;
+                if (a->type == VAL_INT) RA.as.i = (long long)(0 - (unsigned long long)a->as.i);
+                else if (a->type == VAL_DOUBLE) RA.as.d = -a->as.d;
+                else {
+                        runtime_error(vm, "Cannot negate a value of type %s", type_name(a->type));
+                        goto error;
+                }
+                RA.type = a->type;
+                DISPATCH();
+        }
+        CASE(NOT) {
+                int result = !is_truthy(&RB);
+                RA.type = VAL_INT;
+                RA.as.i = result;
+                DISPATCH();
+        }
+        CASE(JMP) {
+                // backwards jumps are loops so they count towards making the function hot
+                if (ARG_sAx(ins) < 0 && vm->jit && function->jitState == JIT_NONE && ++function->loops >= JIT_LOOP_THRESHOLD &&
+                    jit_compile(vm, function)) vm->jitCompiled++;
+                pc += ARG_sAx(ins);
+                DISPATCH();
+        }
+        CASE(JMPF) {
+                BRANCH(is_truthy(&RA));
+                DISPATCH();
+        }
+        CASE(JMPT) {
+                BRANCH(!is_truthy(&RA));
+                DISPATCH();
+        }
+        IF_LESS(IFLT, &RA, &RB, 0)
+        IF_LESS(IFLE, &RA, &RB, 1)
+        CASE(IFEQ) {
+                BRANCH(values_equal(&RA, &RB));
+                DISPATCH();
+        }
+        CASE(IFNE) {
+                BRANCH(!values_equal(&RA, &RB));
+                DISPATCH();
+        }
+        IF_LESS(IFLTK, &RA, &KB, 0)
+        IF_LESS(IFLEK, &RA, &KB, 1)
+        IF_LESS(IFGTK, &KB, &RA, 0)
+        IF_LESS(IFGEK, &KB, &RA, 1)
+        CASE(IFEQK) {
+                BRANCH(values_equal(&RA, &KB));
+                DISPATCH();
+        }
+        CASE(IFNEK) {
+                BRANCH(!values_equal(&RA, &KB));
+                DISPATCH();
+        }
+        CASE(GETPROP) {
+                InlineCache *cache = &function->caches[*pc++];
+                const Value *receiver = &RB;
+                // cache hit is one pointer compare and one load
+                if (receiver->type == VAL_OBJECT && receiver->as.object->shape == cache->shape && cache->slot >= 0) {
+                        RA = receiver->as.object->slots[cache->slot];
+                } else if (!get_property(vm, cache, receiver, &RA)) goto error;
+                DISPATCH();
+        }
+        CASE(SETPROP) {
+                InlineCache *cache = &function->caches[*pc++];
+                const Value *receiver = &RA;
+                if (receiver->type == VAL_OBJECT && receiver->as.object->shape == cache->shape && cache->slot >= 0 &&
+                    (!cache->transition || cache->slot < receiver->as.object->slotCap)) {
+                        Instance *object = receiver->as.object;
+                        if (cache->transition) object->shape = cache->transition;
+                        object->slots[cache->slot] = RB;
+                } else if (!set_property(vm, cache, receiver, &RB)) goto error;
+                DISPATCH();
+        }
+        CASE(INVOKE) {
+                InlineCache *cache = &function->caches[*pc++];
+                Value *receiver = &RA;
+                int argc = ARG_B(ins);
+                Function *method;
+                SAVE_PC();
+                if (receiver->type == VAL_OBJECT && receiver->as.object->shape == cache->shape && cache->method &&
+                    receiver->as.object->klass == cache->klass) {
+                        method = cache->method;
+                } else {
+                        if (receiver->type != VAL_OBJECT) {
+                                runtime_error(vm, "Only objects have methods not %s", type_name(receiver->type));
+                                goto error;
+                        }
+                        Instance *object = receiver->as.object;
+                        int slot = shape_find(object->shape, cache->name);
+                        if (slot >= 0) {
+                                // a field holding something callable gets called like a normal function
+                                *receiver = object->slots[slot];
+                                if (!call_value(vm, receiver, argc)) goto error;
+                                LOAD_FRAME();
+                                DISPATCH();
+                        }
+                        method = class_find_method(object->klass, cache->name);
+                        if (!method) {
+                                runtime_error(vm, "Undefined method '%s'", symbol_name(vm->symbols, cache->name));
+                                goto error;
+                        }
+                        cache->shape = object->shape;
+                        cache->slot = -1;
+                        cache->transition = NULL;
+                        cache->method = method;
+                        cache->klass = object->klass;
+                }
+                if (!push_frame(vm, method, receiver, receiver, argc)) goto error;
+                LOAD_FRAME();
+                DISPATCH();
+        }
+        CASE(CALL) {
+                SAVE_PC();
+                if (!call_value(vm, &RA, ARG_B(ins))) goto error;
+                LOAD_FRAME();
+                DISPATCH();
+        }
+        CASE(RETURN) {
+                Frame *frame = &vm->frames[--vm->frameCount];
+                Value result;
+                if (function->isConstructor) result = base[0];
+                else if (ARG_B(ins)) result = RA;
+                else result.type = VAL_NIL;
+                *frame->ret = result;
+                if (vm->frameCount == 0) return 0;
+                LOAD_FRAME();
+                DISPATCH();
+        }
+
+        END_DISPATCH()
+
+error:
+        {
+                size_t line = 0;
+                if (vm->frameCount > 0) {
+                        Frame *frame = &vm->frames[vm->frameCount - 1];
+                        Function *at = frame->function;
+                        // the current frame has the live pc everything under it saved theirs on the way into the call
+                        uint32_t *where = at == function ? pc : frame->pc;
+                        if (where > at->code) line = at->lines[where - at->code - 1];
+                }
+                fprintf(stderr, "RUNTIME ERROR: %s \nLINE : %lu\n", vm->error, line);
+                for (int i = vm->frameCount - 1; i >= 0; i--) {
+                        fprintf(stderr, "        in %s\n", symbol_name(vm->symbols, vm->frames[i].function->name));
+                }
+                vm->frameCount = 0;
+        }
+        return 1;
+
+#undef LOAD_FRAME
+#undef SAVE_PC
+#undef RA
+#undef RB
+#undef RC
+#undef KB
+#undef KC
+#undef CASE
+#undef DISPATCH
+#undef BEGIN_DISPATCH
+#undef END_DISPATCH
+#undef ARITH
+#undef ARITH_SLOW
+#undef BRANCH
+#undef IF_LESS
+}
@@ -0,0 +1,196 @@
+// this is the header for the virtual machine that runs compiled .unn programs
+// values, objects, classes and functions live here and Bytecode.h has the instruction set and the compiler
+
+#ifndef VM_H
+#define VM_H
+
+#include <stdio.h> // standard i/o lib for C
+#include <stdlib.h> // standard lib for C
+#include <string.h> // lib for string functions like strcmp()
+#include <stdint.h> // fixed width ints for the instruction words
+#include "Symbol_Table.h" // names of variables properties functions and classes
+
+#define STACK_LEN 65536 // registers shared by every frame on the call stack
+#define FRAMES_LEN 1024 // maximum call depth
+#define OPCODE_LIMIT 256 // opcodes are 8 bits so the profiler keeps one counter for each possible value
+
+// every kind of value a register can hold
+typedef enum {
+        VAL_NIL, VAL_INT, VAL_DOUBLE, VAL_STRING, VAL_FUNCTION, VAL_NATIVE, VAL_CLASS, VAL_OBJECT,
+        VAL_METHOD, // a method read off an object with obj.name, calling it calls the method with that object as this
+} ValueType;
+
+struct VM;
+struct Value;
+
+// built in functions written in C return 0 and set the vm error if something went wrong
+typedef int (*NativeFn)(struct VM *vm, struct Value *args, int count, struct Value *result);
+
+// everything the vm allocates while running is linked together so vm_free can get rid of all of it
+typedef struct Obj {
+        struct Obj *next;
+        void *extra; // memory owned by the object that is not part of its own allocation (grown instance slots)
+} Obj;
+
+typedef struct String {
+        Obj obj;
+        size_t length;
+        char chars[];
+} String;
+
+// a value is a type tag and a union big enough for any of the types 16 bytes in total
+typedef struct Value {
+        ValueType type;
+        union {
+                long long i;
+                double d;
+                String *string;
+                struct Function *function;
+                NativeFn native;
+                struct Class *klass;
+                struct Instance *object;
+                struct BoundMethod *method;
+        } as;
+} Value;
+
+// a shape (hidden class) describes which fields an object has and in which slot each one lives
+// objects that got their fields added in the same order share a shape so property access can be cached per shape
+typedef struct Shape {
+        struct Shape *parent; // shape before the last field was added
+        int slotCount; // number of fields
+        int *names; // names[slot] is the symbol of the field stored in that slot
+        struct Shape **transitions; // shapes made by adding one more field to this one
+        int transitionCount;
+} Shape;
+
+// an inline cache lives next to every property access in the bytecode and remembers what happened last time
+// if the next object has the same shape we can skip the lookup entirely
+typedef struct {
+        int name; // symbol of the property
+        Shape *shape; // shape seen last time NULL until the first lookup
+        int slot; // slot the property was found in or -1 if it was a method
+        Shape *transition; // for stores that add a field the shape the object moves to
+        struct Function *method; // for method calls the method that was found
+        struct Class *klass; // for method calls the class it was found in, classes with the same fields share shapes
+} InlineCache;
+
+// what the JIT did with a function
+typedef enum {
+        JIT_NONE, // not hot enough yet
+        JIT_COMPILED, // jitCode is ready to run
+        JIT_UNSUPPORTED // has instructions the JIT cant translate so it stays in the interpreter
+} JitState;
+
+typedef struct Function {
+        int name; // symbol of the function name
+        int arity; // number of parameters not counting this
+        int registers; // registers a frame for this function needs
+        int isMethod; // methods get this in register 0 and their parameters after it
+        int isConstructor; // constructors return this no matter what
+        uint32_t *code; // instruction words
+        size_t *lines; // source line of every instruction word for runtime errors
+        size_t codeLen;
+        size_t codeCap;
+        Value *constants; // constant table (numbers and strings)
+        size_t constCount;
+        size_t constCap;
+        InlineCache *caches; // one per property access
+        size_t cacheCount;
+        size_t cacheCap;
+        unsigned long calls; // times the interpreter has called this function
+        unsigned long loops; // backwards jumps taken while interpreting it
+        int jitState; // JIT_NONE until the JIT has had a go at it
+        void *jitCode; // machine code from JIT.c or NULL
+        size_t jitSize;
+} Function;
+
+typedef struct Class {
+        int name; // symbol of the class name
+        struct Class *parent; // class this one extends or NULL
+        Shape *shape; // shape every new object of this class starts with (all declared fields)
+        Function *constructor; // runs the field initializers and then init
+        int *methodNames; // symbol of each method
+        Function **methods;
+        int methodCount;
+} Class;
+
+typedef struct Instance {
+        Obj obj;
+        Class *klass;
+        Shape *shape;
+        Value *slots; // field values indexed by the slot numbers in shape
+        int slotCap;
+} Instance;
+
+typedef struct BoundMethod {
+        Obj obj;
+        Value receiver;
+        struct Function *method;
+} BoundMethod;
+
+// one entry on the call stack
+typedef struct {
+        Function *function;
+        uint32_t *pc; // where to continue in function when a call returns
+        Value *base; // register 0 of the frame
+        Value *ret; // register in the caller that gets the return value
+} Frame;
+
+typedef struct VM {
+        SymbolTable *symbols; // ownSymbols unless vm_init_symbols was given a table that outlives the vm
+        SymbolTable ownSymbols;
+        Value *stack; // register file for every frame
+        Value *stackEnd;
+        Frame frames[FRAMES_LEN];
+        int frameCount;
+        Value *globals; // functions classes and built ins indexed by global slot
+        int *globalNames; // symbol for each global slot
+        size_t globalCount;
+        size_t globalCap;
+        Function **functions; // every function the compiler made so vm_free can free them
+        size_t functionCount;
+        size_t functionCap;
+        Class **classes; // same for classes
+        size_t classCount;
+        size_t classCap;
+        Shape *rootShape; // shape with no fields every other shape grows out of
+        Obj *objects; // strings and instances made at runtime
+        char error[256]; // message of the last runtime error
+        int profile; // count how many times every opcode runs
+        unsigned long long counts[OPCODE_LIMIT];
+        int jit; // compile hot functions to machine code (on by default where the JIT is available)
+        int jitCompiled; // number of functions the JIT compiled
+} VM;
+
+// sets up an empty vm with the built in functions (print, clock) registered as globals
+void vm_init(VM *vm);
+// same as vm_init but names get interned into symbols which the caller keeps (the compile server keeps one warm)
+void vm_init_symbols(VM *vm, SymbolTable *symbols);
+// frees everything the vm owns
+void vm_free(VM *vm);
+// makes a new empty function owned by the vm
+Function *vm_new_function(VM *vm, const char *name);
+// makes a new empty class owned by the vm
+Class *vm_new_class(VM *vm, const char *name);
+// returns the global slot for name creating it (as nil) if it does not exist yet
+int vm_global(VM *vm, const char *name);
+// returns the global slot for name or -1
+int vm_find_global(VM *vm, const char *name);
+// makes a string value owned by the vm
+Value vm_string(VM *vm, const char *chars, size_t length);
+// runs main and returns 0 on success or 1 after printing a runtime error
+int vm_run(VM *vm, Function *main);
+// prints the opcode counts collected while profiling
+void vm_print_profile(VM *vm, FILE *out);
+
+// returns the shape with name added as the next slot reusing the transition if another object already made it
+Shape *shape_add(Shape *shape, int name);
+// returns the slot of name in shape or -1
+int shape_find(const Shape *shape, int name);
+// looks a method up in a class and its parents
+Function *class_find_method(const Class *klass, int name);
+
+// prints a value the way print() shows it
+void print_value(FILE *out, Value value);
+
+#endif
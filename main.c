@@ -0,0 +1,303 @@
+// this is the driver it reads a .unn file and sends it through the lexer the parser the compiler and the vm
+//
+// usage: ./unn [options] [file.unn]   (file defaults to test.unn like the old drivers)
+// a file that starts with imports is built as a program of several modules (see Build.h) before it runs
+//   --tokens    print the token stream (comments are not in it, the lexer strips them)
+//   --trivia    print the comments and whitespace the lexer took out with the token each one sits in front of
+//   --rebuild   check that the tokens and trivia put back together with lexer_rebuild give exactly the file again
+//   --ast       print the syntax tree
+//   --disasm    print the bytecode of every function
+//   --profile   count how many times every opcode runs and print the counts after the program ends
+//   --time      print how long compiling and running took
+//   --no-jit    run everything in the interpreter (--profile does this too so every instruction gets counted)
+//   --parallel  parse the top level declarations on every core (see Parallel_Parser.h)
+//   --jobs N    same as --parallel but with N threads (also the number of modules compiled at once)
+//   --pipeline  read lex and parse the file at the same time on three threads (see Pipeline.h, the server has its cache)
+//   --build     only bring the build directory up to date, the path can also be a directory of modules
+//   --index     bring the identifier index of a directory (default .) up to date (see Index.h)
+//   --refs NAME print every use of the identifier NAME from the index of the directory
+//
+// ./unn --server [socket] keeps running and takes these same command lines from unn-client instead (see Server.h)
+//
+// build: gcc -O2 -pthread main.c DFA_Lexer.c Parser.c Parallel_Parser.c Symbol_Table.c Bytecode.c VM.c JIT.c Module.c Build.c Server.c Index.c Pipeline.c -lm -o unn
+
+#include <time.h> // clock_gettime for --time
+#include "Bytecode.h"
+#include "Parallel_Parser.h"
+#include "Build.h"
+#include "Server.h"
+#include "Index.h"
+#include "Pipeline.h"
+
+static double now_seconds(void) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return (double)now.tv_sec + (double)now.tv_nsec / 1e9;
+}
+
+static void usage(const char *program) {
+        fprintf(stderr, "usage: %s [--tokens] [--trivia] [--rebuild] [--ast] [--disasm] [--profile] [--time] [--no-jit] [--parallel] [--jobs N] [--pipeline] [--build] [--index] [--refs NAME] [file.unn | dir]\n       %s --server [socket]\n", program, program);
+}
+
+static void print_tokens(const Token *tokens, size_t count) {
+        for (size_t i = 0; i < count; i++) {
+                printf("Type : %d, Lexeme : '%s', Line : %lu, Col : %lu\n", tokens[i].type, tokens[i].lexeme, tokens[i].line, tokens[i].col);
+        }
+}
+
+// prints the trivia table like the tokens with newlines and tabs escaped so every item stays on one line
+static void print_trivia(const TriviaTable *trivia) {
+        static const char *kinds[] = {"space", "line comment", "block comment"};
+        for (size_t i = 0; i < trivia->count; i++) {
+                const Trivia *item = &trivia->items[i];
+                printf("Trivia : %s, Token : %zu, Text : '", kinds[item->kind], item->token);
+                for (size_t k = 0; k < item->length; k++) {
+                        char c = trivia->text[item->text + k];
+                        if (c == '\n') fputs("\\n", stdout);
+                        else if (c == '\t') fputs("\\t", stdout);
+                        else if (c == '\r') fputs("\\r", stdout);
+                        else putchar(c);
+                }
+                printf("'\n");
+        }
+}
+
+// puts the tokens and trivia back together and compares that with the source they were lexed from
+static int check_rebuild(const char *source, size_t length, const Token *tokens, size_t count, const TriviaTable *trivia) {
+        char *rebuilt = NULL;
+        size_t rebuiltLength = 0;
+        FILE *out = open_memstream(&rebuilt, &rebuiltLength);
+        if (!out) {
+                perror("REBUILD ERROR");
+                return 0;
+        }
+        lexer_rebuild(out, source, tokens, count, trivia);
+        fclose(out);
+        size_t at = 0;
+        while (at < length && at < rebuiltLength && source[at] == rebuilt[at]) at++;
+        int ok = at == length && at == rebuiltLength;
+        if (ok) fprintf(stderr, "rebuild : %zu tokens and %zu trivia give back all %zu bytes\n", count, trivia->count, length);
+        else fprintf(stderr, "REBUILD ERROR: The rebuilt source is %zu bytes and differs from the %zu byte file at byte %zu\n", rebuiltLength, length, at);
+        free(rebuilt);
+        return ok;
+}
+
+static int has_imports(const char *source) {
+        char **paths;
+        size_t count = module_scan_imports(source, &paths);
+        for (size_t i = 0; i < count; i++) free(paths[i]);
+        free(paths);
+        return count > 0;
+}
+
+// builds every module the entry file needs and runs them (or only builds them with --build)
+static int run_modules(Server *server, const char *path, int buildOnly, int jobs, int showCode, int profile, int timing, int jit) {
+        double start = now_seconds();
+        Build build;
+        int status = build_run(&build, path, jobs > 0 ? jobs : parallel_default_jobs());
+        double built = now_seconds();
+        if (buildOnly || timing) {
+                fprintf(stderr, "build : %zu modules, %zu compiled, %zu failed, %.3f ms\n", build.orderCount, build.compiled, build.failed, (built - start) * 1000.0);
+        }
+        if (status != 0 || buildOnly) {
+                build_free(&build);
+                return status;
+        }
+
+        if (server_fork(server, &status)) {
+                VM vm;
+                vm_init_symbols(&vm, server ? &server->symbols : NULL);
+                vm.profile = profile;
+                vm.jit = vm.jit && jit && !profile;
+                double loaded = now_seconds();
+                status = build_exec(&build, &vm, showCode ? stdout : NULL);
+                double finished = now_seconds();
+
+                if (profile) vm_print_profile(&vm, stderr);
+                if (timing) fprintf(stderr, "build : %.3f ms, run : %.3f ms, jit compiled : %d functions\n", (built - start) * 1000.0, (finished - loaded) * 1000.0, vm.jitCompiled);
+                vm_free(&vm);
+                server_exit(server, status);
+        }
+        build_free(&build);
+        return status;
+}
+
+// updates the identifier index of dir and or looks a name up in it
+static int run_index(const char *dir, int update, const char *name, int jobs, int timing) {
+        double start = now_seconds();
+        if (update) {
+                IndexStats stats;
+                if (index_update(dir, jobs > 0 ? jobs : parallel_default_jobs(), &stats)) return 1;
+                fprintf(stderr, "index : %zu files, %zu lexed, %zu identifiers, %zu uses, %.3f ms\n", stats.files, stats.lexed, stats.idents, stats.occurrences, (now_seconds() - start) * 1000.0);
+        }
+        if (!name) return 0;
+        start = now_seconds();
+        long found = index_query(dir, name, stdout);
+        if (timing) fprintf(stderr, "refs : %ld found, %.3f ms\n", found, (now_seconds() - start) * 1000.0);
+        return found < 0;
+}
+
+// everything one command line does, server is NULL unless the compile server is running it for a client
+static int run_command(int argc, char **argv, Server *server) {
+        const char *path = NULL, *refs = NULL;
+        int showTokens = 0, showTrivia = 0, rebuild = 0, showAst = 0, showCode = 0, profile = 0, timing = 0, jit = 1, jobs = 0, buildOnly = 0, indexOnly = 0, pipeline = 0;
+
+        for (int i = 1; i < argc; i++) {
+                if (strcmp(argv[i], "--tokens") == 0) showTokens = 1;
+                else if (strcmp(argv[i], "--trivia") == 0) showTrivia = 1;
+                else if (strcmp(argv[i], "--rebuild") == 0) rebuild = 1;
+                else if (strcmp(argv[i], "--ast") == 0) showAst = 1;
+                else if (strcmp(argv[i], "--disasm") == 0) showCode = 1;
+                else if (strcmp(argv[i], "--profile") == 0) profile = 1;
+                else if (strcmp(argv[i], "--time") == 0) timing = 1;
+                else if (strcmp(argv[i], "--no-jit") == 0) jit = 0;
+                else if (strcmp(argv[i], "--parallel") == 0) jobs = parallel_default_jobs();
+                else if (strcmp(argv[i], "--jobs") == 0 && i + 1 < argc) jobs = atoi(argv[++i]);
+                else if (strcmp(argv[i], "--pipeline") == 0) pipeline = 1;
+                else if (strcmp(argv[i], "--build") == 0) buildOnly = 1;
+                else if (strcmp(argv[i], "--index") == 0) indexOnly = 1;
+                else if (strcmp(argv[i], "--refs") == 0 && i + 1 < argc) refs = argv[++i];
+                else if (argv[i][0] == '-') {
+                        usage(argv[0]);
+                        return 1;
+                } else path = argv[i];
+        }
+
+        if (indexOnly || refs) return run_index(path ? path : ".", indexOnly, refs, jobs, timing);
+        if (!path) path = "test.unn";
+        if (buildOnly) return run_modules(server, path, buildOnly, jobs, showCode, profile, timing, jit);
+        double start = now_seconds();
+        Token *tokens = NULL;
+        size_t count = 0;
+        Node *program;
+        Arena arena;
+        Parser parser;
+        TriviaTable trivia;
+        trivia_init(&trivia);
+        int rebuilt = 1; // the --rebuild check passed (or was not asked for)
+        // the server keeps the trees of files that did not change so it only lexes and parses the rest
+        CachedFile *cached = server ? server_source(server, path, jobs) : NULL;
+        if (server) {
+                if (!cached) return 1;
+                if (cached->hasImports) return run_modules(server, path, buildOnly, jobs, showCode, profile, timing, jit);
+                program = cached->program;
+        } else if (pipeline) {
+                // reading lexing and parsing all overlap so the tokens only get printed once everything is parsed
+                Pipeline stages;
+                TrieNode *keywords = lexer_keywords();
+                arena_init(&arena);
+                program = pipeline_parse(path, keywords, showTrivia || rebuild ? &trivia : NULL, &parser, &arena, &stages);
+                freeTrie(keywords);
+                if (!program) {
+                        perror("Could not open file");
+                        arena_free(&arena);
+                        trivia_free(&trivia);
+                        return 1;
+                }
+                tokens = parser.tokens;
+                count = parser.count;
+                if (has_imports(stages.source)) {
+                        free(stages.source);
+                        parser_free(&parser);
+                        arena_free(&arena);
+                        free(tokens);
+                        trivia_free(&trivia);
+                        return run_modules(server, path, buildOnly, jobs, showCode, profile, timing, jit);
+                }
+                if (timing) fprintf(stderr, "pipeline : first token %.3f ms, first declaration %.3f ms, reader waited %zu times, lexer waited %zu times\n", stages.firstToken * 1000.0, stages.firstDeclaration * 1000.0, stages.readerWaits, stages.lexerWaits);
+                if (showTokens) print_tokens(tokens, count);
+                if (showTrivia) print_trivia(&trivia);
+                if (rebuild) rebuilt = check_rebuild(stages.source, stages.length, tokens, count, &trivia);
+                free(stages.source);
+                trivia_free(&trivia);
+                if (print_diagnostics(parser.diags, parser.diagCount) || !rebuilt) {
+                        parser_free(&parser);
+                        arena_free(&arena);
+                        free(tokens);
+                        return 1;
+                }
+        } else {
+                // reading the file into a buffer and passing the entire file as a self contained string to the lexer
+                size_t length = 0;
+                char *input = read_source(path, &length);
+                if (!input) {
+                        perror("Could not open file");
+                        return 1; // Exit if the file cannot be opened
+                }
+                if (has_imports(input)) {
+                        free(input);
+                        return run_modules(server, path, buildOnly, jobs, showCode, profile, timing, jit);
+                }
+
+                // comments are only kept (next to the tokens) when they get printed or checked
+                TrieNode *keywords = lexer_keywords();
+                tokens = lexer_run_stripped(input, &count, keywords, showTrivia || rebuild ? &trivia : NULL); // run operations on text with buffer
+                freeTrie(keywords);
+                if (tokens && rebuild) rebuilt = check_rebuild(input, length, tokens, count, &trivia);
+                free(input); // Free allocated memory
+                if (!tokens) return 1;
+                if (showTokens) print_tokens(tokens, count);
+                if (showTrivia) print_trivia(&trivia);
+                trivia_free(&trivia);
+                arena_init(&arena);
+                parser_init(&parser, tokens, count, &arena);
+                program = jobs > 1 ? parse_program_parallel(&parser, jobs) : parse_program(&parser);
+                if (print_diagnostics(parser.diags, parser.diagCount) || !rebuilt) {
+                        parser_free(&parser);
+                        arena_free(&arena);
+                        free(tokens);
+                        return 1;
+                }
+        }
+
+        if ((showTokens || showTrivia || rebuild) && server) {
+                // the cache has no tokens or trivia so the file gets lexed again just for this
+                size_t length = 0;
+                char *input = read_source(path, &length);
+                Token *again = input ? lexer_run_stripped(input, &count, server->keywords, showTrivia || rebuild ? &trivia : NULL) : NULL;
+                if (again && showTokens) print_tokens(again, count);
+                if (again && showTrivia) print_trivia(&trivia);
+                if (rebuild) rebuilt = again && check_rebuild(input, length, again, count, &trivia);
+                trivia_free(&trivia);
+                free(again);
+                free(input);
+                if (!rebuilt) return 1;
+        }
+        if (showAst) print_ast(stdout, program, 0);
+
+        VM vm;
+        vm_init_symbols(&vm, server ? &server->symbols : NULL);
+        vm.profile = profile;
+        vm.jit = vm.jit && jit && !profile;
+        Function *main = compile_program(&vm, program);
+        if (!server) {
+                parser_free(&parser);
+                arena_free(&arena);
+                free(tokens);
+        }
+        if (!main) {
+                vm_free(&vm);
+                return 1;
+        }
+        if (showCode) {
+                for (size_t i = 0; i < vm.functionCount; i++) disassemble(&vm, vm.functions[i], stdout);
+        }
+
+        double compiled = now_seconds();
+        int status = 0;
+        if (server_fork(server, &status)) {
+                status = vm_run(&vm, main);
+                double finished = now_seconds();
+
+                if (profile) vm_print_profile(&vm, stderr);
+                if (timing) fprintf(stderr, "compile : %.3f ms, run : %.3f ms, jit compiled : %d functions\n", (compiled - start) * 1000.0, (finished - compiled) * 1000.0, vm.jitCompiled);
+                server_exit(server, status);
+        }
+        vm_free(&vm);
+        return status;
+}
+
+int main(int argc, char **argv) {
+        if (argc > 1 && strcmp(argv[1], "--server") == 0) return server_run(argc > 2 ? argv[2] : NULL, run_command);
+        return run_command(argc, argv, NULL);
+}